@@ -25,7 +25,6 @@
 #include <pmix.h>
 #include <pmix_server.h>
 
-#include "codec.h"
 #include "interthread.h"
 
 #include "abort.h"
@@ -33,6 +32,7 @@
 struct abort {
     flux_shell_t *shell;
     struct interthread *it;
+    int upcall_type;                // interthread message type
     int trace_flag;
 };
 
@@ -41,53 +41,76 @@ struct abort {
  */
 static struct abort *global_abort_ctx;
 
-static void abort_shell_cb (const flux_msg_t *msg, void *arg)
-{
-    json_t *xproc;
-    json_t *xserver_object;
-    json_t *xprocs;
-    json_t *xcbfunc;
-    json_t *xcbdata;
+struct abort_call {
     pmix_proc_t proc;
-    void *server_object;
     int status;
+    char *message;
     pmix_proc_t *procs;
     size_t nprocs;
-    const char *message;
     pmix_op_cbfunc_t cbfunc;
     void *cbdata;
+};
 
-    if (flux_msg_unpack (msg,
-                         "{s:o s:o s:i s:s s:o s:o s:o}",
-                         "proc", &xproc,
-                         "server_object", &xserver_object,
-                         "status", &status,
-                         "msg", &message,
-                         "procs", &xprocs,
-                         "cbfunc", &xcbfunc,
-                         "cbdata", &xcbdata) < 0
-        || codec_proc_decode (xproc, &proc) < 0
-        || codec_pointer_decode (xserver_object, &server_object) < 0
-        || codec_proc_array_decode (xprocs, &procs, &nprocs) < 0
-        || codec_pointer_decode (xcbfunc, (void **)&cbfunc) < 0
-        || codec_pointer_decode (xcbdata, &cbdata) < 0) {
-        shell_warn ("error unpacking interthread abort_upcall message");
-        free (procs);
-        return;
+static void abort_call_destroy (struct abort_call *acall)
+{
+    if (acall) {
+        int saved_errno = errno;
+        free (acall->message);
+        free (acall->procs);
+        free (acall);
+        errno = saved_errno;
     }
+}
+
+/* Copy the abort arguments into a call record for the shell thread.
+ * N.B. this runs in the pmix server thread.
+ */
+static struct abort_call *abort_call_create (const pmix_proc_t *proc,
+                                             int status,
+                                             const char *message,
+                                             const pmix_proc_t procs[],
+                                             size_t nprocs,
+                                             pmix_op_cbfunc_t cbfunc,
+                                             void *cbdata)
+{
+    struct abort_call *acall;
+
+    if (!(acall = calloc (1, sizeof (*acall))))
+        return NULL;
+    acall->proc = *proc;
+    acall->status = status;
+    if (!(acall->message = strdup (message ? message : "(no message)")))
+        goto error;
+    if (nprocs > 0) {
+        if (!(acall->procs = malloc (nprocs * sizeof (procs[0]))))
+            goto error;
+        memcpy (acall->procs, procs, nprocs * sizeof (procs[0]));
+        acall->nprocs = nprocs;
+    }
+    acall->cbfunc = cbfunc;
+    acall->cbdata = cbdata;
+    return acall;
+error:
+    abort_call_destroy (acall);
+    return NULL;
+}
+
+static void abort_shell_cb (void *rec, void *arg)
+{
+    struct abort_call *acall = rec;
 
     flux_shell_raise ("exec",
                       0,
                       "%s.%d called PMIx_Abort (status=%d): %s",
-                      proc.nspace,
-                      proc.rank,
-                      status,
-                      message);
+                      acall->proc.nspace,
+                      acall->proc.rank,
+                      acall->status,
+                      acall->message);
 
-    if (cbfunc)
-        cbfunc (PMIX_SUCCESS, cbdata); // release the calling process
+    if (acall->cbfunc)
+        acall->cbfunc (PMIX_SUCCESS, acall->cbdata); // release the caller
 
-    free (procs);
+    abort_call_destroy (acall);
 }
 
 int abort_server_cb (const pmix_proc_t *proc,
@@ -100,38 +123,21 @@ int abort_server_cb (const pmix_proc_t *proc,
                      void *cbdata)
 {
     struct abort *abort = global_abort_ctx;
-    json_t *xproc = NULL;
-    json_t *xserver_object = NULL;
-    json_t *xprocs = NULL;
-    json_t *xcbfunc = NULL;
-    json_t *xcbdata = PMIX_SUCCESS;
-    int rc = PMIX_SUCCESS;
-
-    if (!(xproc = codec_proc_encode (proc))
-        || !(xserver_object = codec_pointer_encode (server_object))
-        || !(xprocs = codec_proc_array_encode (procs, nprocs))
-        || !(xcbfunc = codec_pointer_encode (cbfunc))
-        || !(xcbdata = codec_pointer_encode (cbdata))
-        || interthread_send_pack (abort->it,
-                                  "abort_upcall",
-                                  "{s:O s:O s:i s:s s:O s:O s:O}",
-                                  "proc", xproc,
-                                  "server_object", xserver_object,
-                                  "status", status,
-                                  "msg", msg ? msg : "(no message)",
-                                  "procs", xprocs,
-                                  "cbfunc", xcbfunc,
-                                  "cbdata", xcbdata) < 0) {
+    struct abort_call *acall;
+
+    if (!(acall = abort_call_create (proc,
+                                     status,
+                                     msg,
+                                     procs,
+                                     nprocs,
+                                     cbfunc,
+                                     cbdata))
+        || interthread_send (abort->it, abort->upcall_type, acall) < 0) {
         fprintf (stderr, "error sending abort_upcall interthread message\n");
-        rc = PMIX_ERROR;
+        abort_call_destroy (acall);
+        return PMIX_ERROR;
     }
-    json_decref (xproc);
-    json_decref (xserver_object);
-    json_decref (xprocs);
-    json_decref (xcbfunc);
-    json_decref (xcbdata);
-
-    return rc;
+    return PMIX_SUCCESS;
 }
 
 void abort_destroy (struct abort *abort)
@@ -153,7 +159,11 @@ struct abort *abort_create (flux_shell_t *shell, struct interthread *it)
     abort->shell = shell;
     abort->it = it;
     abort->trace_flag = 1; // stuck on for now
-    if (interthread_register (it, "abort_upcall", abort_shell_cb, abort) < 0)
+    if ((abort->upcall_type = interthread_register (it,
+                                                    "abort_upcall",
+                                                    abort_shell_cb,
+                                                    abort,
+                                                    INTERTHREAD_URGENT)) < 0)
         goto error;
     global_abort_ctx = abort;
     return abort;
@@ -0,0 +1,510 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* allgather.c - peer to peer exchange algorithms
+ *
+ * Unlike the tree in exchange.c, these algorithms have no root.  Every
+ * shell sends one message and receives one message per step.  Messages
+ * are one-way pmix-allgather requests (FLUX_RPC_NORESPONSE) with a small
+ * header identifying the sequence number, algorithm, and step, followed
+ * by blobvec segments.  A message may arrive before this shell has
+ * entered the allgather, or before the step it belongs to, so it is
+ * held until needed.
+ *
+ * ring
+ *   N-1 steps.  In step s, send the segment received in step s-1 (or our
+ *   own in step 0) to rank+1 and receive one from rank-1.  Each link
+ *   carries each segment once, so this is bandwidth optimal for large
+ *   payloads, but latency is linear in N.
+ *
+ * bruck
+ *   ceil(log2 N) steps.  In step k with d = 2^k, send the first
+ *   min(d, N-d) segments gathered so far to rank-d and receive as many
+ *   from rank+d.  Works for any N.  Suits medium payloads.
+ *
+ * dissemination
+ *   ceil(log2 N) steps.  In step k, send an empty message to rank+2^k
+ *   and wait for one from rank-2^k.  A barrier - no data is exchanged.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <flux/core.h>
+#include <flux/shell.h>
+
+#include "blobvec.h"
+#include "brokermap.h"
+
+#include "allgather.h"
+
+struct agsession {
+    uint32_t seq;
+    int algo;
+    int nsteps;
+    int step;                       // current step
+    bool sent;                      // message for current step was sent
+    struct blobvec **recv;          // received segments, indexed by step
+    struct blobvec *result;
+    allgather_exit_f exit_cb;
+    void *exit_cb_arg;
+
+    struct allgather *ag;
+    bool local;                     // allgather_enter() was called
+    bool has_error;
+
+    struct agsession *next;
+};
+
+struct allgather {
+    flux_shell_t *shell;
+    int size;
+    int rank;
+    char *topic;                    // shell service topic for pmix-allgather
+    struct brokermap *brokermap;    // broker rank by shell rank
+    struct agsession *sessions;
+    bool entered;                   // allgather_enter() was ever called
+    uint32_t last_seq;              // last sequence number entered
+};
+
+/* Header at the front of each pmix-allgather request payload.
+ * Integers are in network byte order.
+ */
+struct aghdr {
+    uint32_t seq;
+    uint32_t algo;
+    uint32_t step;
+};
+
+static const struct {
+    const char *name;
+    int algo;
+} algotab[] = {
+    { "ring", ALLGATHER_RING },
+    { "bruck", ALLGATHER_BRUCK },
+    { "dissemination", ALLGATHER_DISSEMINATION },
+};
+
+int allgather_algo_lookup (const char *name)
+{
+    if (name) {
+        for (int i = 0; i < sizeof (algotab) / sizeof (algotab[0]); i++) {
+            if (!strcmp (algotab[i].name, name))
+                return algotab[i].algo;
+        }
+    }
+    return -1;
+}
+
+static bool algo_valid (int algo)
+{
+    for (int i = 0; i < sizeof (algotab) / sizeof (algotab[0]); i++) {
+        if (algotab[i].algo == algo)
+            return true;
+    }
+    return false;
+}
+
+/* Number of steps needed for 'algo' on 'size' shells.
+ */
+static int step_count (int algo, int size)
+{
+    int nsteps = 0;
+
+    if (algo == ALLGATHER_RING)
+        return size - 1;
+    while ((1 << nsteps) < size)
+        nsteps++;
+    return nsteps;
+}
+
+static void agsession_destroy (struct agsession *ses)
+{
+    if (ses) {
+        int saved_errno = errno;
+        if (ses->recv) {
+            for (int i = 0; i < ses->nsteps; i++)
+                blobvec_destroy (ses->recv[i]);
+            free (ses->recv);
+        }
+        blobvec_destroy (ses->result);
+        free (ses);
+        errno = saved_errno;
+    }
+}
+
+static struct agsession *agsession_create (struct allgather *ag,
+                                           int algo,
+                                           uint32_t seq)
+{
+    struct agsession *ses;
+
+    if (!(ses = calloc (1, sizeof (*ses))))
+        return NULL;
+    ses->ag = ag;
+    ses->seq = seq;
+    ses->algo = algo;
+    ses->nsteps = step_count (algo, ag->size);
+    if (ses->nsteps > 0) {
+        if (!(ses->recv = calloc (ses->nsteps, sizeof (ses->recv[0]))))
+            goto error;
+    }
+    if (!(ses->result = blobvec_create ()))
+        goto error;
+    return ses;
+error:
+    agsession_destroy (ses);
+    return NULL;
+}
+
+/* Find session 'seq', creating it if it doesn't exist.
+ * Fail with EINVAL if 'algo' is unknown or the session exists with a
+ * different algorithm.  Since sequence numbers are entered in increasing
+ * order, and a session exists until it is complete, fail with ESTALE if
+ * there is no session for 'seq' and it has already been entered.
+ */
+static struct agsession *agsession_lookup (struct allgather *ag,
+                                           int algo,
+                                           uint32_t seq)
+{
+    struct agsession *ses;
+
+    if (!algo_valid (algo)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (ses = ag->sessions; ses != NULL; ses = ses->next) {
+        if (ses->seq == seq) {
+            if (ses->algo != algo) {
+                errno = EINVAL;
+                return NULL;
+            }
+            return ses;
+        }
+    }
+    if (ag->entered && seq <= ag->last_seq) {
+        errno = ESTALE;
+        return NULL;
+    }
+    if (!(ses = agsession_create (ag, algo, seq)))
+        return NULL;
+    ses->next = ag->sessions;
+    ag->sessions = ses;
+    return ses;
+}
+
+static void agsession_unlink (struct allgather *ag, struct agsession *ses)
+{
+    struct agsession **sp;
+
+    for (sp = &ag->sessions; *sp != NULL; sp = &(*sp)->next) {
+        if (*sp == ses) {
+            *sp = ses->next;
+            break;
+        }
+    }
+}
+
+/* Send a one-way pmix-allgather message for the current step to 'rank'.
+ */
+static int send_step (struct agsession *ses,
+                      int rank,
+                      const void *data,
+                      size_t size)
+{
+    struct allgather *ag = ses->ag;
+    flux_t *h = flux_shell_get_flux (ag->shell);
+    struct aghdr hdr = {
+        .seq = htonl (ses->seq),
+        .algo = htonl (ses->algo),
+        .step = htonl (ses->step),
+    };
+    int nodeid;
+    uint8_t *buf;
+    flux_future_t *f;
+
+    if ((nodeid = brokermap_lookup (ag->brokermap, rank)) < 0
+        || !(buf = malloc (sizeof (hdr) + size)))
+        return -1;
+    memcpy (buf, &hdr, sizeof (hdr));
+    if (size > 0)
+        memcpy (buf + sizeof (hdr), data, size);
+    f = flux_rpc_raw (h,
+                      ag->topic,
+                      buf,
+                      sizeof (hdr) + size,
+                      nodeid,
+                      FLUX_RPC_NORESPONSE);
+    free (buf);
+    if (!f)
+        return -1;
+    flux_future_destroy (f);
+    return 0;
+}
+
+static int send_current_step (struct agsession *ses)
+{
+    struct allgather *ag = ses->ag;
+    int dist = 1 << ses->step;
+    const void *buf = NULL;
+    size_t size = 0;
+
+    switch (ses->algo) {
+        case ALLGATHER_RING:
+            if (ses->step == 0) {
+                if (blobvec_encode (ses->result, &buf, &size) < 0)
+                    return -1;
+            }
+            else {
+                if (blobvec_encode (ses->recv[ses->step - 1],
+                                    &buf,
+                                    &size) < 0)
+                    return -1;
+            }
+            return send_step (ses, (ag->rank + 1) % ag->size, buf, size);
+        case ALLGATHER_BRUCK: {
+            int count = dist < ag->size - dist ? dist : ag->size - dist;
+            if (blobvec_encode_prefix (ses->result, count, &buf, &size) < 0)
+                return -1;
+            return send_step (ses,
+                              (ag->rank - dist + ag->size) % ag->size,
+                              buf,
+                              size);
+        }
+        case ALLGATHER_DISSEMINATION:
+            return send_step (ses, (ag->rank + dist) % ag->size, NULL, 0);
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/* Check the segments received in the current step and add them to result.
+ */
+static int recv_current_step (struct agsession *ses)
+{
+    struct allgather *ag = ses->ag;
+    struct blobvec *bv = ses->recv[ses->step];
+    int dist = 1 << ses->step;
+    int count = 0;
+    const void *buf;
+    size_t size;
+
+    switch (ses->algo) {
+        case ALLGATHER_RING:
+            count = 1;
+            break;
+        case ALLGATHER_BRUCK:
+            count = dist < ag->size - dist ? dist : ag->size - dist;
+            break;
+    }
+    if (blobvec_count (bv) != count) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (count > 0) {
+        if (blobvec_encode (bv, &buf, &size) < 0
+            || blobvec_extend (ses->result, buf, size) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void agsession_process (struct agsession *ses)
+{
+    struct allgather *ag = ses->ag;
+
+    /* Awaiting self?  An error is reported once it arrives.
+     */
+    if (!ses->local)
+        return;
+    if (ses->has_error)
+        goto done;
+
+    while (ses->step < ses->nsteps) {
+        if (!ses->sent) {
+            if (send_current_step (ses) < 0) {
+                shell_warn ("error sending pmix-allgather step %d: %s",
+                            ses->step,
+                            strerror (errno));
+                ses->has_error = 1;
+                goto done;
+            }
+            ses->sent = true;
+        }
+        /* Awaiting peer input?
+         */
+        if (!ses->recv[ses->step])
+            return;
+        if (recv_current_step (ses) < 0) {
+            shell_warn ("error receiving pmix-allgather step %d: %s",
+                        ses->step,
+                        strerror (errno));
+            ses->has_error = 1;
+            goto done;
+        }
+        ses->step++;
+        ses->sent = false;
+    }
+done:
+    agsession_unlink (ag, ses);
+    ses->exit_cb (ses->has_error ? NULL : ses->result, ses->exit_cb_arg);
+    agsession_destroy (ses);
+}
+
+static void msg_decref (void *arg)
+{
+    flux_msg_decref (arg);
+}
+
+/* peer shell sent a pmix-allgather message.
+ * These are one-way messages, so errors are logged, not returned.
+ */
+static void allgather_request_cb (flux_t *h,
+                                  flux_msg_handler_t *mh,
+                                  const flux_msg_t *msg,
+                                  void *arg)
+{
+    struct allgather *ag = arg;
+    const void *buf;
+    size_t size;
+    struct aghdr hdr;
+    struct agsession *ses;
+    struct blobvec *bv;
+    int step;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &size) < 0)
+        goto error;
+    if (size < sizeof (hdr)) {
+        errno = EPROTO;
+        goto error;
+    }
+    memcpy (&hdr, buf, sizeof (hdr));
+    if (!(ses = agsession_lookup (ag, ntohl (hdr.algo), ntohl (hdr.seq)))) {
+        /* A peer may still send to a session that failed here.
+         */
+        if (errno == ESTALE)
+            return;
+        goto error;
+    }
+    step = ntohl (hdr.step);
+    if (step < 0 || step >= ses->nsteps || ses->recv[step] != NULL) {
+        errno = EPROTO;
+        ses->has_error = 1;
+        goto error_process;
+    }
+    if (!(bv = blobvec_wrap ((uint8_t *)buf + sizeof (hdr),
+                             size - sizeof (hdr),
+                             msg_decref,
+                             (void *)msg))) {
+        ses->has_error = 1;
+        goto error_process;
+    }
+    flux_msg_incref (msg);
+    ses->recv[step] = bv;
+    agsession_process (ses);
+    return;
+error_process:
+    shell_warn ("error handling pmix-allgather message: %s",
+                strerror (errno));
+    if (ses->local)
+        agsession_process (ses);
+    return;
+error:
+    shell_warn ("error handling pmix-allgather message: %s",
+                strerror (errno));
+}
+
+int allgather_enter (struct allgather *ag,
+                     int algo,
+                     uint32_t seq,
+                     const void *data,
+                     size_t size,
+                     allgather_exit_f exit_cb,
+                     void *exit_cb_arg)
+{
+    struct agsession *ses;
+
+    if (!ag
+        || !exit_cb
+        || (size > 0 && !data)
+        || (algo == ALLGATHER_DISSEMINATION && data != NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(ses = agsession_lookup (ag, algo, seq)))
+        return -1;
+    if (ses->local) {
+        errno = EEXIST;
+        return -1;
+    }
+    /* Block counting algorithms require exactly one segment per shell,
+     * so contribute an empty one if there is no data.
+     */
+    if (algo != ALLGATHER_DISSEMINATION) {
+        if (blobvec_append (ses->result, ag->rank, data, size) < 0)
+            return -1;
+    }
+    ses->exit_cb = exit_cb;
+    ses->exit_cb_arg = exit_cb_arg;
+    ses->local = 1;
+    ag->entered = true;
+    ag->last_seq = seq;
+    agsession_process (ses);
+    return 0;
+}
+
+struct allgather *allgather_create (flux_shell_t *shell,
+                                    struct brokermap *brokermap)
+{
+    struct allgather *ag;
+    const char *service;
+
+    if (!(ag = calloc (1, sizeof (*ag))))
+        return NULL;
+    ag->shell = shell;
+    ag->brokermap = brokermap;
+    if (flux_shell_info_unpack (shell,
+                                "{s:i s:i s:s}",
+                                "size", &ag->size,
+                                "rank", &ag->rank,
+                                "service", &service) < 0)
+        goto error;
+    if (asprintf (&ag->topic, "%s.pmix-allgather", service) < 0)
+        goto error;
+    if (flux_shell_service_register (shell,
+                                     "pmix-allgather",
+                                     allgather_request_cb,
+                                     ag) < 0)
+        goto error;
+    return ag;
+error:
+    allgather_destroy (ag);
+    return NULL;
+}
+
+void allgather_destroy (struct allgather *ag)
+{
+    if (ag) {
+        int saved_errno = errno;
+        struct agsession *ses;
+        while ((ses = ag->sessions)) {
+            ag->sessions = ses->next;
+            agsession_destroy (ses);
+        }
+        free (ag->topic);
+        free (ag);
+        errno = saved_errno;
+    }
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,54 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_ALLGATHER_H
+#define _PX_ALLGATHER_H
+
+#include <stdint.h>
+#include <flux/shell.h>
+
+#include "blobvec.h"
+#include "brokermap.h"
+
+enum {
+    ALLGATHER_RING = 1,
+    ALLGATHER_BRUCK = 2,
+    ALLGATHER_DISSEMINATION = 3,    // barrier only, no data
+};
+
+/* Return the algorithm id for 'name', or -1 if unknown.
+ */
+int allgather_algo_lookup (const char *name);
+
+/* 'result' is NULL on failure.  Take a reference to keep it.
+ */
+typedef void (*allgather_exit_f)(struct blobvec *result, void *arg);
+
+/* 'brokermap' is shared with the caller, and must outlive the allgather.
+ */
+struct allgather *allgather_create (flux_shell_t *shell,
+                                    struct brokermap *brokermap);
+void allgather_destroy (struct allgather *ag);
+
+/* Contribute 'data' to allgather 'seq' using algorithm 'algo'.
+ * All shells must use the same algorithm for a given sequence number,
+ * and enter sequence numbers in increasing order.
+ */
+int allgather_enter (struct allgather *ag,
+                     int algo,
+                     uint32_t seq,
+                     const void *data,
+                     size_t size,
+                     allgather_exit_f exit_cb,
+                     void *exit_cb_arg);
+
+#endif // _PX_ALLGATHER_H
+
+// vi:ts=4 sw=4 expandtab
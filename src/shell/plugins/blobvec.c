@@ -0,0 +1,380 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* blobvec.c - helper class for length-prefixed data segments
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "blobvec.h"
+
+#define BLOBVEC_CHUNK 4096
+
+#define HDR_SIZE (2 * sizeof (uint32_t))
+
+struct blobvec {
+    int refcount;
+    uint8_t *buf;
+    size_t size;
+    size_t length;      // allocated size of buf
+    int count;
+    size_t datasize;
+    size_t cursor;      // offset of next segment for blobvec_next()
+
+    blobvec_free_f free_fn; // if set, buf is borrowed and read-only
+    void *free_arg;
+};
+
+static int grow (struct blobvec *bv, size_t needed)
+{
+    if (bv->size + needed > bv->length) {
+        size_t new_length = bv->length ? bv->length : BLOBVEC_CHUNK;
+        uint8_t *new_buf;
+
+        while (new_length < bv->size + needed)
+            new_length *= 2;
+        if (!(new_buf = realloc (bv->buf, new_length)))
+            return -1;
+        bv->buf = new_buf;
+        bv->length = new_length;
+    }
+    return 0;
+}
+
+static void put_hdr (uint8_t *p, uint32_t id, uint32_t size)
+{
+    uint32_t n;
+
+    n = htonl (id);
+    memcpy (p, &n, sizeof (n));
+    n = htonl (size);
+    memcpy (p + sizeof (n), &n, sizeof (n));
+}
+
+static void get_hdr (const uint8_t *p, uint32_t *id, uint32_t *size)
+{
+    uint32_t n;
+
+    memcpy (&n, p, sizeof (n));
+    *id = ntohl (n);
+    memcpy (&n, p + sizeof (n), sizeof (n));
+    *size = ntohl (n);
+}
+
+/* Walk wire-format segments in 'buf' to make sure they are well formed,
+ * and tally the segment count and data size.
+ */
+static int validate (const uint8_t *buf,
+                     size_t size,
+                     int *countp,
+                     size_t *datasizep)
+{
+    size_t offset = 0;
+    int count = 0;
+    size_t datasize = 0;
+
+    while (offset < size) {
+        uint32_t id;
+        uint32_t segsize;
+
+        if (size - offset < HDR_SIZE)
+            goto eproto;
+        get_hdr (buf + offset, &id, &segsize);
+        offset += HDR_SIZE;
+        if (size - offset < segsize)
+            goto eproto;
+        offset += segsize;
+        datasize += segsize;
+        count++;
+    }
+    *countp = count;
+    *datasizep = datasize;
+    return 0;
+eproto:
+    errno = EPROTO;
+    return -1;
+}
+
+int blobvec_append (struct blobvec *bv,
+                    uint32_t id,
+                    const void *data,
+                    size_t size)
+{
+    if (!bv || (size > 0 && !data)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (bv->free_fn) {
+        errno = EROFS;
+        return -1;
+    }
+    if (size > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if (grow (bv, HDR_SIZE + size) < 0)
+        return -1;
+    put_hdr (bv->buf + bv->size, id, size);
+    if (size > 0)
+        memcpy (bv->buf + bv->size + HDR_SIZE, data, size);
+    bv->size += HDR_SIZE + size;
+    bv->datasize += size;
+    bv->count++;
+    return 0;
+}
+
+int blobvec_extend (struct blobvec *bv, const void *buf, size_t size)
+{
+    int count;
+    size_t datasize;
+
+    if (!bv || (size > 0 && !buf)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (bv->free_fn) {
+        errno = EROFS;
+        return -1;
+    }
+    if (validate (buf, size, &count, &datasize) < 0)
+        return -1;
+    if (size > 0) {
+        if (grow (bv, size) < 0)
+            return -1;
+        memcpy (bv->buf + bv->size, buf, size);
+        bv->size += size;
+        bv->datasize += datasize;
+        bv->count += count;
+    }
+    return 0;
+}
+
+int blobvec_encode (struct blobvec *bv, const void **buf, size_t *size)
+{
+    if (!bv || !buf || !size) {
+        errno = EINVAL;
+        return -1;
+    }
+    *buf = bv->buf;
+    *size = bv->size;
+    return 0;
+}
+
+int blobvec_encode_prefix (struct blobvec *bv,
+                           int count,
+                           const void **buf,
+                           size_t *size)
+{
+    size_t offset = 0;
+
+    if (!bv || count < 0 || count > bv->count || !buf || !size) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (count-- > 0) {
+        uint32_t id;
+        uint32_t segsize;
+
+        get_hdr (bv->buf + offset, &id, &segsize);
+        offset += HDR_SIZE + segsize;
+    }
+    *buf = bv->buf;
+    *size = offset;
+    return 0;
+}
+
+int blobvec_count (struct blobvec *bv)
+{
+    return bv ? bv->count : 0;
+}
+
+size_t blobvec_datasize (struct blobvec *bv)
+{
+    return bv ? bv->datasize : 0;
+}
+
+/* A segment in wire format, for sorting.
+ */
+struct seg {
+    const uint8_t *p;
+    size_t len;
+};
+
+static int seg_cmp (const void *a, const void *b)
+{
+    const struct seg *s1 = a;
+    const struct seg *s2 = b;
+
+    if (s1->len != s2->len)
+        return s1->len < s2->len ? -1 : 1;
+    return memcmp (s1->p, s2->p, s1->len);
+}
+
+/* Fill 'segs' with the segments of 'bv', sorted.
+ */
+static void sort_segs (struct blobvec *bv, struct seg *segs)
+{
+    size_t offset = 0;
+    int i = 0;
+
+    while (offset < bv->size) {
+        uint32_t id;
+        uint32_t segsize;
+
+        get_hdr (bv->buf + offset, &id, &segsize);
+        segs[i].p = bv->buf + offset;
+        segs[i].len = HDR_SIZE + segsize;
+        offset += segs[i++].len;
+    }
+    qsort (segs, bv->count, sizeof (segs[0]), seg_cmp);
+}
+
+bool blobvec_equal (struct blobvec *a, struct blobvec *b)
+{
+    struct seg *segs;
+    bool equal = true;
+
+    if (!a || !b)
+        return a == b;
+    if (a->size != b->size || a->count != b->count)
+        return false;
+    if (a->size == 0 || !memcmp (a->buf, b->buf, a->size))
+        return true;
+    if (!(segs = calloc (2 * a->count, sizeof (segs[0]))))
+        return false;
+    sort_segs (a, segs);
+    sort_segs (b, segs + a->count);
+    for (int i = 0; i < a->count; i++) {
+        if (seg_cmp (&segs[i], &segs[a->count + i]) != 0) {
+            equal = false;
+            break;
+        }
+    }
+    free (segs);
+    return equal;
+}
+
+const void *blobvec_next (struct blobvec *bv, uint32_t *idp, size_t *sizep)
+{
+    uint32_t id;
+    uint32_t size;
+    const void *data;
+
+    if (!bv || bv->cursor >= bv->size)
+        return NULL;
+    get_hdr (bv->buf + bv->cursor, &id, &size);
+    data = bv->buf + bv->cursor + HDR_SIZE;
+    bv->cursor += HDR_SIZE + size;
+    if (idp)
+        *idp = id;
+    if (sizep)
+        *sizep = size;
+    return data;
+}
+
+const void *blobvec_first (struct blobvec *bv, uint32_t *id, size_t *size)
+{
+    if (!bv)
+        return NULL;
+    bv->cursor = 0;
+    return blobvec_next (bv, id, size);
+}
+
+int blobvec_decode (struct blobvec *bv, void **datap, size_t *sizep)
+{
+    uint8_t *data;
+    size_t size = 0;
+    const void *seg;
+    size_t segsize;
+
+    if (!bv || !datap || !sizep) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(data = malloc (bv->datasize > 0 ? bv->datasize : 1)))
+        return -1;
+    seg = blobvec_first (bv, NULL, &segsize);
+    while (seg) {
+        memcpy (data + size, seg, segsize);
+        size += segsize;
+        seg = blobvec_next (bv, NULL, &segsize);
+    }
+    *datap = data;
+    *sizep = size;
+    return 0;
+}
+
+struct blobvec *blobvec_incref (struct blobvec *bv)
+{
+    if (bv)
+        bv->refcount++;
+    return bv;
+}
+
+void blobvec_decref (struct blobvec *bv)
+{
+    if (bv && --bv->refcount == 0) {
+        int saved_errno = errno;
+        if (bv->free_fn)
+            bv->free_fn (bv->free_arg);
+        else
+            free (bv->buf);
+        free (bv);
+        errno = saved_errno;
+    }
+}
+
+void blobvec_destroy (struct blobvec *bv)
+{
+    blobvec_decref (bv);
+}
+
+struct blobvec *blobvec_create (void)
+{
+    struct blobvec *bv;
+
+    if (!(bv = calloc (1, sizeof (*bv))))
+        return NULL;
+    bv->refcount = 1;
+    return bv;
+}
+
+struct blobvec *blobvec_wrap (const void *buf,
+                              size_t size,
+                              blobvec_free_f free_fn,
+                              void *arg)
+{
+    struct blobvec *bv;
+    int count;
+    size_t datasize;
+
+    if ((size > 0 && !buf) || !free_fn) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (validate (buf, size, &count, &datasize) < 0
+        || !(bv = blobvec_create ()))
+        return NULL;
+    bv->buf = (uint8_t *)buf;
+    bv->size = bv->length = size;
+    bv->count = count;
+    bv->datasize = datasize;
+    bv->free_fn = free_fn;
+    bv->free_arg = arg;
+    return bv;
+}
+
+// vi:ts=4 sw=4 expandtab
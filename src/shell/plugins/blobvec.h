@@ -0,0 +1,95 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_BLOBVEC_H
+#define _PX_BLOBVEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* A blobvec is an ordered list of opaque data segments, each tagged with
+ * a 32-bit id (the shell rank that contributed it).  Segments are stored
+ * in wire format so that the whole vector can be sent in a flux message
+ * payload without further encoding:
+ *
+ *   [id:u32][size:u32][size bytes]...
+ *
+ * with integers in network byte order.
+ */
+
+typedef void (*blobvec_free_f)(void *arg);
+
+struct blobvec *blobvec_create (void);
+
+/* Create a read-only blobvec that refers to an existing wire-format buffer
+ * without copying it, e.g. the payload of a received message.  The buffer
+ * is validated first (EPROTO if malformed).  'free_fn' is called with
+ * 'arg' when the last reference is dropped.  The blobvec may not be
+ * modified (EROFS).
+ */
+struct blobvec *blobvec_wrap (const void *buf,
+                              size_t size,
+                              blobvec_free_f free_fn,
+                              void *arg);
+
+/* blobvecs are reference counted.  blobvec_destroy() drops a reference.
+ */
+struct blobvec *blobvec_incref (struct blobvec *bv);
+void blobvec_decref (struct blobvec *bv);
+void blobvec_destroy (struct blobvec *bv);
+
+/* Append one segment.
+ */
+int blobvec_append (struct blobvec *bv,
+                    uint32_t id,
+                    const void *data,
+                    size_t size);
+
+/* Append wire-format segments, e.g. received in a message payload.
+ * The buffer is validated before anything is added.  Fails with EPROTO
+ * if it is malformed.
+ */
+int blobvec_extend (struct blobvec *bv, const void *buf, size_t size);
+
+/* Access the wire-format buffer.  It remains valid until 'bv' is modified.
+ */
+int blobvec_encode (struct blobvec *bv, const void **buf, size_t *size);
+
+/* Access the wire-format buffer holding only the first 'count' segments.
+ */
+int blobvec_encode_prefix (struct blobvec *bv,
+                           int count,
+                           const void **buf,
+                           size_t *size);
+
+int blobvec_count (struct blobvec *bv);
+
+/* Sum of segment sizes, not counting framing.
+ */
+size_t blobvec_datasize (struct blobvec *bv);
+
+/* Return true if 'a' and 'b' hold the same segments, in any order.
+ * Returns false if that can't be determined, e.g. out of memory.
+ */
+bool blobvec_equal (struct blobvec *a, struct blobvec *b);
+
+/* Iterate over segments.  Return NULL when there are no more.
+ */
+const void *blobvec_first (struct blobvec *bv, uint32_t *id, size_t *size);
+const void *blobvec_next (struct blobvec *bv, uint32_t *id, size_t *size);
+
+/* Concatenate segment data into one buffer that the caller must free.
+ */
+int blobvec_decode (struct blobvec *bv, void **data, size_t *size);
+
+#endif // _PX_BLOBVEC_H
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,85 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* brokermap.c - lazily built shell rank => broker rank table
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <flux/shell.h>
+
+#include "brokermap.h"
+
+struct brokermap {
+    flux_shell_t *shell;
+    int size;
+    int *ranks;                     // broker rank by shell rank, -1=unknown
+};
+
+struct brokermap *brokermap_create (flux_shell_t *shell)
+{
+    struct brokermap *bm;
+
+    if (!(bm = calloc (1, sizeof (*bm))))
+        return NULL;
+    bm->shell = shell;
+    if (flux_shell_info_unpack (shell, "{s:i}", "size", &bm->size) < 0)
+        goto error;
+    if (!(bm->ranks = malloc (bm->size * sizeof (bm->ranks[0]))))
+        goto error;
+    for (int i = 0; i < bm->size; i++)
+        bm->ranks[i] = -1;
+    return bm;
+error:
+    brokermap_destroy (bm);
+    return NULL;
+}
+
+void brokermap_destroy (struct brokermap *bm)
+{
+    if (bm) {
+        int saved_errno = errno;
+        free (bm->ranks);
+        free (bm);
+        errno = saved_errno;
+    }
+}
+
+int brokermap_lookup (struct brokermap *bm, int rank)
+{
+    if (rank < 0 || rank >= bm->size) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (bm->ranks[rank] < 0) {
+        int broker_rank;
+        if (flux_shell_rank_info_unpack (bm->shell,
+                                         rank,
+                                         "{s:i}",
+                                         "broker_rank", &broker_rank) < 0)
+            return -1;
+        bm->ranks[rank] = broker_rank;
+    }
+    return bm->ranks[rank];
+}
+
+const int *brokermap_array (struct brokermap *bm)
+{
+    for (int i = 0; i < bm->size; i++) {
+        if (brokermap_lookup (bm, i) < 0)
+            return NULL;
+    }
+    return bm->ranks;
+}
+
+// vi:ts=4 sw=4 expandtab
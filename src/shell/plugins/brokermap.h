@@ -0,0 +1,34 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_BROKERMAP_H
+#define _PX_BROKERMAP_H
+
+#include <flux/shell.h>
+
+/* Shell rank => broker rank table, shared by the exchange algorithms.
+ * An entry is taken from the shell rank info the first time it is used,
+ * since most shells only ever send to a few others.
+ */
+struct brokermap *brokermap_create (flux_shell_t *shell);
+void brokermap_destroy (struct brokermap *bm);
+
+/* Return the broker rank of shell 'rank', or -1 on error.
+ */
+int brokermap_lookup (struct brokermap *bm, int rank);
+
+/* Return the broker ranks of all shells, indexed by shell rank,
+ * or NULL on error.
+ */
+const int *brokermap_array (struct brokermap *bm);
+
+#endif // _PX_BROKERMAP_H
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,120 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* delta.c - delta encoding caches for the exchange gather
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <flux/core.h>
+
+#include "blobvec.h"
+#include "delta.h"
+
+/* Parent's copy of the last request from a child that carried data.
+ */
+struct delta_child {
+    const flux_msg_t *msg;
+    uint32_t seq;
+};
+
+struct delta {
+    int size;
+    struct blobvec *sent;           // data last sent in full
+    uint32_t sent_seq;              // exchange that sent it
+    struct delta_child *children;   // by shell rank (allocated on demand)
+};
+
+struct delta *delta_create (int size)
+{
+    struct delta *d;
+
+    if (!(d = calloc (1, sizeof (*d))))
+        return NULL;
+    d->size = size;
+    return d;
+}
+
+void delta_destroy (struct delta *d)
+{
+    if (d) {
+        int saved_errno = errno;
+        blobvec_decref (d->sent);
+        if (d->children) {
+            for (int i = 0; i < d->size; i++)
+                flux_msg_decref (d->children[i].msg);
+            free (d->children);
+        }
+        free (d);
+        errno = saved_errno;
+    }
+}
+
+bool delta_check (struct delta *d,
+                  uint32_t seq,
+                  struct blobvec *bv,
+                  uint32_t *base)
+{
+    if (d->sent && blobvec_equal (bv, d->sent)) {
+        *base = d->sent_seq;
+        return true;
+    }
+    blobvec_decref (d->sent);
+    d->sent = blobvec_incref (bv);
+    d->sent_seq = seq;
+    return false;
+}
+
+void delta_reset (struct delta *d)
+{
+    blobvec_decref (d->sent);
+    d->sent = NULL;
+}
+
+int delta_save (struct delta *d,
+                uint32_t rank,
+                uint32_t seq,
+                const flux_msg_t *msg)
+{
+    struct delta_child *c;
+
+    if (rank >= d->size) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (!d->children
+        && !(d->children = calloc (d->size, sizeof (d->children[0]))))
+        return -1;
+    c = &d->children[rank];
+    flux_msg_decref (c->msg);
+    c->msg = flux_msg_incref (msg);
+    c->seq = seq;
+    return 0;
+}
+
+const flux_msg_t *delta_lookup (struct delta *d, uint32_t rank, uint32_t seq)
+{
+    struct delta_child *c;
+
+    if (!d->children || rank >= d->size)
+        goto eproto;
+    c = &d->children[rank];
+    if (!c->msg || c->seq != seq)
+        goto eproto;
+    return c->msg;
+eproto:
+    errno = EPROTO;
+    return NULL;
+}
+
+// vi:ts=4 sw=4 expandtab
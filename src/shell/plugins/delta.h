@@ -0,0 +1,65 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_DELTA_H
+#define _PX_DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <flux/core.h>
+
+#include "blobvec.h"
+
+/* Delta encoding of the exchange tree gather, for pmix.exchange.delta.
+ *
+ * Each shell keeps the last subtree data it sent up the tree in full, and
+ * each parent keeps that last full request from each child, tagged with
+ * its sequence number.  When a shell's subtree data is the same, e.g.
+ * repeated fences during init, it sends only a header that refers to the
+ * earlier exchange, and the parent reuses the cached request.
+ */
+
+/* 'size' is the number of shell ranks.
+ */
+struct delta *delta_create (int size);
+void delta_destroy (struct delta *d);
+
+/* Sender: if 'bv' is the same as the data last sent in full (compared
+ * byte for byte, in any segment order), set 'base' to the sequence number
+ * of the exchange that sent it and return true.  Otherwise remember 'bv'
+ * as sent in full by exchange 'seq' and return false.
+ */
+bool delta_check (struct delta *d,
+                  uint32_t seq,
+                  struct blobvec *bv,
+                  uint32_t *base);
+
+/* Sender: forget the data last sent in full, so the next request is sent
+ * in full, e.g. when this shell's parent changes.  Parents keep their
+ * copies, since a reference names the exchange.
+ */
+void delta_reset (struct delta *d);
+
+/* Parent: keep request 'msg' from child 'rank', which carries the data
+ * of exchange 'seq', for later requests that refer to it.
+ */
+int delta_save (struct delta *d,
+                uint32_t rank,
+                uint32_t seq,
+                const flux_msg_t *msg);
+
+/* Parent: return the request from child 'rank' that carried the data of
+ * exchange 'seq'.  Fails with EPROTO if it isn't the one kept.
+ */
+const flux_msg_t *delta_lookup (struct delta *d, uint32_t rank, uint32_t seq);
+
+#endif // _PX_DELTA_H
+
+// vi:ts=4 sw=4 expandtab
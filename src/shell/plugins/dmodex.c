@@ -10,9 +10,32 @@
 
 /* dmodex.c - handle direct_modex callback from openpmix server
  *
- * This is just the interthread plumbing at this point.
- * We'll see if the lack of direct_modex implementation seems
- * to be causing any real problems before filling in the rest.
+ * When a local client asks for data of a proc that was not exchanged by
+ * a fence, the server calls direct_modex.  The request is passed to the
+ * shell thread, which sends a pmix-dmodex RPC to the shell that hosts the
+ * proc.  That shell calls PMIx_server_dmodex_request() for each requested
+ * rank, which completes in the pmix server thread once the proc has
+ * committed its data.  The data is passed back to the shell thread with
+ * an interthread message, and once the proc is done, returned as a
+ * blobvec with one segment per rank (see blobvec.h).  The requesting
+ * shell completes the server callback with the segment of the proc.
+ *
+ * If the pmix.dmodex.cache shell option is set, the requesting shell
+ * keeps fetched data in a cache keyed by nspace and rank, bounded by that
+ * many bytes with LRU eviction, so local clients that look up the same
+ * remote proc are served without another RPC.  Since procs may commit new
+ * data, the cache is cleared when a fence completes, and is bypassed by
+ * requests that set PMIX_GET_REFRESH_CACHE.  Requests for a proc whose
+ * fetch is still pending wait for it instead of sending their own.
+ *
+ * If the pmix.dmodex.bulk shell option is set, a miss fetches the data of
+ * all procs hosted by the remote shell that are not already cached or
+ * pending, in one RPC, on the assumption that neighbors on the same node
+ * are requested next.  The response is sent as soon as the requested proc
+ * is done, and includes only the neighbors whose data was available by
+ * then, so a neighbor that has not committed yet cannot hold it up.
+ * Neighbors left out are fetched again if a local client is waiting for
+ * them, and forgotten otherwise.
  */
 
 #if HAVE_CONFIG_H
@@ -21,26 +44,99 @@
 #include <jansson.h>
 #include <flux/core.h>
 #include <flux/shell.h>
+#include <flux/taskmap.h>
+#include <flux/idset.h>
 #include <pmix.h>
 #include <pmix_server.h>
 
-#include "codec.h"
 #include "interthread.h"
+#include "blobvec.h"
 
 #include "dmodex.h"
 
+#define DMODEX_BUCKETS 256
+
+/* One pmix-dmodex RPC in flight, serving one or more pending entries.
+ */
+struct dmodex_fetch {
+    flux_future_t *f;
+    int shell_rank;
+    int rank;                       // requested proc (others are neighbors)
+    struct dmodex_entry **entries;
+    int count;
+    struct dmodex_fetch *next;
+};
+
+/* Data fetched for one remote proc.  While the fetch is pending, later
+ * requests for the same proc wait on the entry instead of sending another
+ * RPC.  Once fetched, the entry stays in the cache in LRU order.
+ */
+struct dmodex_entry {
+    pmix_proc_t proc;
+    void *data;
+    size_t size;
+    struct dmodex_fetch *fetch;     // pending fetch (NULL once complete)
+    bool cached;                    // entry is on the LRU list
+    bool stale;                     // fetch started before a cache clear
+    struct dmodex_call *waiters;    // requests awaiting the fetch
+    struct dmodex_entry *hnext;     // hash chain
+    struct dmodex_entry *prev;      // LRU list, most recently used first
+    struct dmodex_entry *next;
+};
+
+/* A pmix-dmodex request received from another shell.  Each requested
+ * rank has a part, which is the cbdata of its PMIx_server_dmodex_request().
+ */
+struct dmodex_part {
+    struct dmodex_request *req;
+    int rank;
+};
+
+/* Completion of one part, passed from the pmix server thread.
+ */
+struct dmodex_response {
+    struct dmodex_part *part;
+    int status;
+    size_t size;
+    char data[];
+};
+
+struct dmodex_request {
+    const flux_msg_t *msg;
+    struct blobvec *bv;
+    int rank;                       // requested proc (others are neighbors)
+    int pending;                    // parts not yet complete
+    int status;                     // status of the requested proc
+    bool responded;
+    int count;
+    struct dmodex_part parts[];
+};
+
 struct dmodex {
     flux_shell_t *shell;
     struct interthread *it;
+    int upcall_type;                // interthread message types
+    int response_type;
+    const struct taskmap *taskmap;
+    int *shell_ranks;               // proc rank => shell rank (-1 if none)
+    int shell_rank;                 // this shell
+    int nranks;
+    bool bulk;                      // fetch all procs of a remote shell
+    struct dmodex_fetch *fetches;   // fetches in flight
+    struct dmodex_entry *hash[DMODEX_BUCKETS];
+    struct dmodex_entry *lru_head;
+    struct dmodex_entry *lru_tail;
+    size_t cache_size;              // bytes of cached data
+    size_t cache_max;               // cache size limit (0=disabled)
 };
 
 struct dmodex_call {
     pmix_proc_t proc;
-    pmix_info_t *info;
-    size_t ninfo;
+    bool refresh;                   // bypass the cache
     int shell_rank;
     pmix_modex_cbfunc_t cbfunc;
     void *cbdata;
+    struct dmodex_call *next;       // next waiter on the same entry
 };
 
 /* This is for the benefit of server callbacks that don't have
@@ -52,78 +148,523 @@ static void dmodex_call_destroy (struct dmodex_call *dxcall)
 {
     if (dxcall) {
         int saved_errno = errno;
-        codec_info_array_destroy (dxcall->info, dxcall->ninfo);
         free (dxcall);
         errno = saved_errno;
     };
 }
 
-static struct dmodex_call *dmodex_call_create (void)
+/* Copy the direct_modex arguments into a call record for the shell thread.
+ * N.B. this runs in the pmix server thread.
+ */
+static struct dmodex_call *dmodex_call_create (const pmix_proc_t *proc,
+                                               const pmix_info_t info[],
+                                               size_t ninfo,
+                                               pmix_modex_cbfunc_t cbfunc,
+                                               void *cbdata)
 {
     struct dmodex_call *dxcall;
 
     if (!(dxcall = calloc (1, sizeof (*dxcall))))
         return NULL;
+    dxcall->proc = *proc;
+    for (int i = 0; i < ninfo; i++) {
+        if (!strcmp (info[i].key, PMIX_GET_REFRESH_CACHE)
+            && info[i].value.type == PMIX_BOOL
+            && info[i].value.data.flag == true)
+            dxcall->refresh = true;
+    }
+    dxcall->cbfunc = cbfunc;
+    dxcall->cbdata = cbdata;
+    dxcall->shell_rank = -1;
     return dxcall;
 }
 
+static void dmodex_entry_destroy (struct dmodex_entry *entry)
+{
+    if (entry) {
+        int saved_errno = errno;
+        struct dmodex_call *dxcall;
+        while ((dxcall = entry->waiters)) {
+            entry->waiters = dxcall->next;
+            dmodex_call_destroy (dxcall);
+        }
+        free (entry->data);
+        free (entry);
+        errno = saved_errno;
+    }
+}
+
+static void dmodex_fetch_destroy (struct dmodex_fetch *fetch)
+{
+    if (fetch) {
+        int saved_errno = errno;
+        flux_future_destroy (fetch->f);
+        free (fetch->entries);
+        free (fetch);
+        errno = saved_errno;
+    }
+}
+
+static struct dmodex_entry **entry_slot (struct dmodex *dx,
+                                         const pmix_proc_t *proc)
+{
+    struct dmodex_entry **slot = &dx->hash[proc->rank % DMODEX_BUCKETS];
+
+    while (*slot && !PMIX_CHECK_PROCID (&(*slot)->proc, proc))
+        slot = &(*slot)->hnext;
+    return slot;
+}
+
+static void lru_unlink (struct dmodex *dx, struct dmodex_entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        dx->lru_head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        dx->lru_tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push (struct dmodex *dx, struct dmodex_entry *entry)
+{
+    entry->next = dx->lru_head;
+    if (dx->lru_head)
+        dx->lru_head->prev = entry;
+    else
+        dx->lru_tail = entry;
+    dx->lru_head = entry;
+}
+
+/* Remove 'entry' from the hash and LRU list and destroy it.
+ */
+static void entry_remove (struct dmodex *dx, struct dmodex_entry *entry)
+{
+    struct dmodex_entry **slot = entry_slot (dx, &entry->proc);
+
+    if (*slot == entry)
+        *slot = entry->hnext;
+    if (entry->cached) {
+        lru_unlink (dx, entry);
+        dx->cache_size -= entry->size;
+    }
+    dmodex_entry_destroy (entry);
+}
+
+/* Keep the fetched data of 'entry' in the cache, evicting the least
+ * recently used entries to stay within cache_max.
+ */
+static void entry_cache (struct dmodex *dx, struct dmodex_entry *entry)
+{
+    entry->cached = true;
+    lru_push (dx, entry);
+    dx->cache_size += entry->size;
+    while (dx->cache_size > dx->cache_max && dx->lru_tail)
+        entry_remove (dx, dx->lru_tail);
+}
+
+void dmodex_cache_clear (struct dmodex *dx)
+{
+    for (struct dmodex_fetch *fetch = dx->fetches; fetch; fetch = fetch->next) {
+        for (int i = 0; i < fetch->count; i++)
+            fetch->entries[i]->stale = true;
+    }
+    while (dx->lru_head)
+        entry_remove (dx, dx->lru_head);
+}
+
+/* Complete 'dxcall' with a copy of 'data'.
+ * N.B. pmix calls 'free' on data when it is done with it.
+ */
+static void dmodex_call_respond (struct dmodex_call *dxcall,
+                                 int rc,
+                                 const void *data,
+                                 size_t size)
+{
+    void *cpy = NULL;
+
+    if (rc == PMIX_SUCCESS && size > 0) {
+        if (!(cpy = malloc (size))) {
+            rc = PMIX_ERR_NOMEM;
+            size = 0;
+        }
+        else
+            memcpy (cpy, data, size);
+    }
+    else
+        size = 0;
+    dxcall->cbfunc (rc, cpy, size, dxcall->cbdata, cpy ? free : NULL, cpy);
+    dmodex_call_destroy (dxcall);
+}
+
+/* The fetch of 'entry' is complete.  Respond to the waiters, then cache
+ * the data or drop the entry.
+ */
+static void entry_complete (struct dmodex *dx,
+                            struct dmodex_entry *entry,
+                            int rc,
+                            const void *data,
+                            size_t size)
+{
+    struct dmodex_call *dxcall;
+
+    entry->fetch = NULL;
+    while ((dxcall = entry->waiters)) {
+        entry->waiters = dxcall->next;
+        dmodex_call_respond (dxcall, rc, data, size);
+    }
+    if (rc != PMIX_SUCCESS
+        || entry->stale
+        || dx->cache_max == 0
+        || size > dx->cache_max)
+        goto uncache;
+    if (size > 0) {
+        if (!(entry->data = malloc (size)))
+            goto uncache;
+        memcpy (entry->data, data, size);
+    }
+    entry->size = size;
+    entry_cache (dx, entry);
+    return;
+uncache:
+    entry_remove (dx, entry);
+}
+
 /* Find the shell rank that hosts proc 'rank', or return -1 if not found.
  */
-static int lookup_shell_rank (flux_shell_t *shell, int rank)
+static int lookup_shell_rank (struct dmodex *dx, int rank)
+{
+    if (rank < 0 || rank >= dx->nranks || dx->shell_ranks[rank] < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return dx->shell_ranks[rank];
+}
+
+/* Return true if proc 'rank' is hosted by this shell.
+ */
+static bool is_hosted (struct dmodex *dx, json_int_t rank)
+{
+    return rank >= 0
+        && rank < dx->nranks
+        && dx->shell_ranks[rank] == dx->shell_rank;
+}
+
+/* Build the proc rank => shell rank table from the taskmap, which may
+ * place the tasks of a shell anywhere, e.g. with a cyclic distribution.
+ */
+static int build_shell_ranks (struct dmodex *dx)
 {
     int shell_size;
-    int shell_rank;
-    int base_rank = 0;
 
-    if (flux_shell_info_unpack (shell, "{s:i}", "size", &shell_size) < 0)
+    if (flux_shell_info_unpack (dx->shell,
+                                "{s:i s:i}",
+                                "size", &shell_size,
+                                "rank", &dx->shell_rank) < 0)
+        return -1;
+    dx->nranks = taskmap_total_ntasks (dx->taskmap);
+    if (dx->nranks < 0
+        || !(dx->shell_ranks = malloc (dx->nranks * sizeof (int))))
+        return -1;
+    for (int i = 0; i < dx->nranks; i++)
+        dx->shell_ranks[i] = -1;
+    for (int shell_rank = 0; shell_rank < shell_size; shell_rank++) {
+        const struct idset *taskids;
+        unsigned int id;
+
+        if (!(taskids = taskmap_taskids (dx->taskmap, shell_rank)))
+            return -1;
+        id = idset_first (taskids);
+        while (id != IDSET_INVALID_ID) {
+            if (id < dx->nranks)
+                dx->shell_ranks[id] = shell_rank;
+            id = idset_next (taskids, id);
+        }
+    }
+    return 0;
+}
+
+/* Map a failed pmix-dmodex RPC to a pmix status.
+ */
+static int dmodex_errno_to_status (int errnum)
+{
+    switch (errnum) {
+        case ENOENT:
+            return PMIX_ERR_NOT_FOUND;
+        case EHOSTUNREACH:
+        case ENOSYS:
+            return PMIX_ERR_UNREACH;
+        default:
+            return PMIX_ERROR;
+    }
+}
+
+static int dmodex_status_to_errno (int status)
+{
+    switch (status) {
+        case PMIX_ERR_NOT_FOUND:
+        case PMIX_ERR_PROC_ENTRY_NOT_FOUND:
+            return ENOENT;
+        default:
+            return EIO;
+    }
+}
+
+/* Find the segment of proc 'rank' in the pmix-dmodex response.
+ */
+static const void *response_lookup (struct blobvec *bv,
+                                    int rank,
+                                    size_t *size)
+{
+    const void *data;
+    uint32_t id;
+
+    data = blobvec_first (bv, &id, size);
+    while (data) {
+        if (id == rank)
+            return data;
+        data = blobvec_next (bv, &id, size);
+    }
+    return NULL;
+}
+
+static void msg_decref (void *arg)
+{
+    flux_msg_decref (arg);
+}
+
+static int fetch_start (struct dmodex *dx,
+                        const pmix_proc_t *proc,
+                        int shell_rank,
+                        bool bulk);
+
+/* A neighbor fetched in bulk was left out of the response.  If local
+ * clients are waiting for it, fetch it again on its own.  Otherwise drop
+ * the entry, so the next request for it starts a new fetch.
+ */
+static void entry_refetch (struct dmodex *dx,
+                           struct dmodex_entry *entry,
+                           int shell_rank)
+{
+    struct dmodex_call *waiters = entry->waiters;
+    struct dmodex_call *dxcall;
+    pmix_proc_t proc = entry->proc;
+
+    entry->waiters = NULL;
+    entry_remove (dx, entry);
+    if (!waiters)
+        return;
+    if (fetch_start (dx, &proc, shell_rank, false) < 0) {
+        shell_warn ("error fetching %s.%d from shell rank %d: %s",
+                    proc.nspace,
+                    proc.rank,
+                    shell_rank,
+                    strerror (errno));
+        while ((dxcall = waiters)) {
+            waiters = dxcall->next;
+            dmodex_call_respond (dxcall, PMIX_ERROR, NULL, 0);
+        }
+        return;
+    }
+    entry = *entry_slot (dx, &proc);
+    entry->waiters = waiters;
+}
+
+/* The owning shell has responded to a pmix-dmodex request.
+ * Complete the entry of the requested proc, and of each neighbor that
+ * is in the response.
+ */
+static void dmodex_continuation (flux_future_t *f, void *arg)
+{
+    struct dmodex_fetch *fetch = arg;
+    struct dmodex *dx = global_dmodex_ctx;
+    struct dmodex_fetch **fp;
+    struct blobvec *bv = NULL;
+    const flux_msg_t *msg;
+    const void *buf;
+    size_t size;
+    int rc = PMIX_SUCCESS;
+
+    if (flux_rpc_get_raw (f, &buf, &size) < 0
+        || flux_future_get (f, (const void **)&msg) < 0) {
+        shell_warn ("pmix-dmodex on shell rank %d: %s",
+                    fetch->shell_rank,
+                    future_strerror (f, errno));
+        rc = dmodex_errno_to_status (errno);
+    }
+    else if (!(bv = blobvec_wrap (buf, size, msg_decref, (void *)msg))) {
+        shell_warn ("pmix-dmodex on shell rank %d: %s",
+                    fetch->shell_rank,
+                    strerror (errno));
+        rc = PMIX_ERROR;
+    }
+    else
+        flux_msg_incref (msg);
+    for (int i = 0; i < fetch->count; i++) {
+        struct dmodex_entry *entry = fetch->entries[i];
+        const void *data = NULL;
+        size_t datasize = 0;
+
+        if (rc == PMIX_SUCCESS)
+            data = response_lookup (bv, entry->proc.rank, &datasize);
+        if (entry->proc.rank != fetch->rank) {
+            if (data)
+                entry_complete (dx, entry, PMIX_SUCCESS, data, datasize);
+            else
+                entry_refetch (dx, entry, fetch->shell_rank);
+        }
+        else if (rc == PMIX_SUCCESS && !data)
+            entry_complete (dx, entry, PMIX_ERR_NOT_FOUND, NULL, 0);
+        else
+            entry_complete (dx, entry, rc, data, datasize);
+    }
+    blobvec_decref (bv);
+    for (fp = &dx->fetches; *fp != NULL; fp = &(*fp)->next) {
+        if (*fp == fetch) {
+            *fp = fetch->next;
+            break;
+        }
+    }
+    dmodex_fetch_destroy (fetch);
+}
+
+/* Add a pending entry for 'proc' to 'fetch'.
+ */
+static int fetch_add (struct dmodex *dx,
+                      struct dmodex_fetch *fetch,
+                      const pmix_proc_t *proc)
+{
+    struct dmodex_entry *entry;
+    struct dmodex_entry **slot;
+
+    if (!(entry = calloc (1, sizeof (*entry))))
+        return -1;
+    entry->proc = *proc;
+    entry->fetch = fetch;
+    fetch->entries[fetch->count++] = entry;
+    slot = entry_slot (dx, &entry->proc);
+    entry->hnext = *slot;
+    *slot = entry;
+    return 0;
+}
+
+/* Start fetching the data of 'proc' from 'shell_rank', which hosts it.
+ * If 'bulk' is true, also fetch the other procs hosted by that shell that
+ * have no entry yet.
+ */
+static int fetch_start (struct dmodex *dx,
+                        const pmix_proc_t *proc,
+                        int shell_rank,
+                        bool bulk)
+{
+    struct dmodex_fetch *fetch;
+    const struct idset *taskids = NULL;
+    json_t *ranks = NULL;
+    int count = 0;
+
+    if (bulk) {
+        if (!(taskids = taskmap_taskids (dx->taskmap, shell_rank)))
+            return -1;
+        count = idset_count (taskids);
+    }
+    if (!(fetch = calloc (1, sizeof (*fetch)))
+        || !(fetch->entries = calloc (count + 1, sizeof (fetch->entries[0])))
+        || !(ranks = json_array ()))
         goto error;
-    for (shell_rank = 0; shell_rank < shell_size; shell_rank++) {
-        int ntasks;
-        if (flux_shell_rank_info_unpack (shell,
-                                         shell_rank,
-                                         "{s:i}",
-                                         "ntasks", &ntasks) < 0)
+    fetch->shell_rank = shell_rank;
+    fetch->rank = proc->rank;
+    if (taskids) {
+        unsigned int id = idset_first (taskids);
+        while (id != IDSET_INVALID_ID) {
+            pmix_proc_t p;
+            PMIX_PROC_LOAD (&p, proc->nspace, id);
+            if (!*entry_slot (dx, &p)) {
+                json_t *o;
+                if (!(o = json_integer (id))
+                    || json_array_append_new (ranks, o) < 0) {
+                    json_decref (o);
+                    errno = ENOMEM;
+                    goto error;
+                }
+                if (fetch_add (dx, fetch, &p) < 0)
+                    goto error;
+            }
+            id = idset_next (taskids, id);
+        }
+    }
+    if (!*entry_slot (dx, proc)) { // not hosted there per the taskmap?
+        json_t *o;
+        if (!(o = json_integer (proc->rank))
+            || json_array_append_new (ranks, o) < 0) {
+            json_decref (o);
+            errno = ENOMEM;
+            goto error;
+        }
+        if (fetch_add (dx, fetch, proc) < 0)
             goto error;
-        if (rank >= base_rank && rank < base_rank + ntasks)
-            return shell_rank;
-        base_rank += ntasks;
     }
+    if (!(fetch->f = flux_shell_rpc_pack (dx->shell,
+                                          "pmix-dmodex",
+                                          shell_rank,
+                                          0,
+                                          "{s:s s:i s:O}",
+                                          "nspace", proc->nspace,
+                                          "rank", proc->rank,
+                                          "ranks", ranks))
+        || flux_future_then (fetch->f, -1, dmodex_continuation, fetch) < 0)
+        goto error;
+    json_decref (ranks);
+    fetch->next = dx->fetches;
+    dx->fetches = fetch;
+    return 0;
 error:
-    errno = ENOENT;
+    json_decref (ranks);
+    if (fetch) {
+        for (int i = 0; i < fetch->count; i++)
+            entry_remove (dx, fetch->entries[i]);
+    }
+    dmodex_fetch_destroy (fetch);
     return -1;
 }
 
-static void dmodex_shell_cb (const flux_msg_t *msg, void *arg)
+static void dmodex_shell_cb (void *rec, void *arg)
 {
     struct dmodex *dx = arg;
-    json_t *xproc;
-    json_t *xinfo;
-    json_t *xcbfunc;
-    json_t *xcbdata;
-    struct dmodex_call *dxcall;
+    struct dmodex_call *dxcall = rec;
+    struct dmodex_entry *entry;
     int rc;
 
-    if (!(dxcall = dmodex_call_create ())
-        || flux_msg_unpack (msg,
-                            "{s:o s:o s:o s:o}",
-                            "proc", &xproc,
-                            "info", &xinfo,
-                            "cbfunc", &xcbfunc,
-                            "cbdata", &xcbdata) < 0
-        || codec_proc_decode (xproc, &dxcall->proc) < 0
-        || codec_info_array_decode (xinfo, &dxcall->info, &dxcall->ninfo) < 0
-        || codec_pointer_decode (xcbfunc, (void **)&dxcall->cbfunc) < 0
-        || codec_pointer_decode (xcbdata, &dxcall->cbdata) < 0) {
-        shell_warn ("error unpacking dmodex_upcall interthread message");
-        dmodex_call_destroy (dxcall);
+    entry = *entry_slot (dx, &dxcall->proc);
+    if (entry && entry->cached && dxcall->refresh) {
+        entry_remove (dx, entry);
+        entry = NULL;
+    }
+    if (entry && entry->cached) {
+        lru_unlink (dx, entry);
+        lru_push (dx, entry);
+        dmodex_call_respond (dxcall, PMIX_SUCCESS, entry->data, entry->size);
         return;
     }
-    if ((dxcall->shell_rank = lookup_shell_rank (dx->shell,
-                                                 dxcall->proc.rank)) < 0) {
-        rc = PMIX_ERR_PROC_ENTRY_NOT_FOUND;
-        goto error;
+    if (!entry) {
+        dxcall->shell_rank = lookup_shell_rank (dx, dxcall->proc.rank);
+        if (dxcall->shell_rank < 0) {
+            rc = PMIX_ERR_PROC_ENTRY_NOT_FOUND;
+            goto error;
+        }
+        if (fetch_start (dx,
+                         &dxcall->proc,
+                         dxcall->shell_rank,
+                         dx->bulk) < 0) {
+            rc = PMIX_ERROR;
+            goto error;
+        }
+        entry = *entry_slot (dx, &dxcall->proc);
     }
-    rc = PMIX_ERR_NOT_IMPLEMENTED;
+    dxcall->next = entry->waiters;
+    entry->waiters = dxcall;
+    return;
 error:
     shell_warn ("dmodex_upcall for %s.%d on shell rank %d: %s",
                 dxcall->proc.nspace,
@@ -135,6 +676,192 @@ error:
     dmodex_call_destroy (dxcall);
 }
 
+static void dmodex_request_destroy (struct dmodex_request *req)
+{
+    if (req) {
+        int saved_errno = errno;
+        flux_msg_decref (req->msg);
+        blobvec_decref (req->bv);
+        free (req);
+        errno = saved_errno;
+    }
+}
+
+/* The requested proc is done.  Respond with the data found so far,
+ * or with the error of the requested proc.
+ */
+static void dmodex_request_respond (struct dmodex *dx,
+                                    struct dmodex_request *req)
+{
+    flux_t *h = flux_shell_get_flux (dx->shell);
+    const void *buf;
+    size_t size;
+
+    req->responded = true;
+    if (req->status != PMIX_SUCCESS) {
+        if (flux_respond_error (h,
+                                req->msg,
+                                dmodex_status_to_errno (req->status),
+                                PMIx_Error_string (req->status)) < 0)
+            shell_warn ("error responding to pmix-dmodex request");
+    }
+    else if (blobvec_encode (req->bv, &buf, &size) < 0
+             || flux_respond_raw (h, req->msg, buf, size) < 0) {
+        shell_warn ("error responding to pmix-dmodex request");
+        if (flux_respond_error (h, req->msg, errno, NULL) < 0)
+            shell_warn ("error responding to pmix-dmodex request");
+    }
+}
+
+/* Part 'rank' of 'req' is done with 'status' (rank -1 stands for the
+ * extra pending count held while the parts are started).  Respond once
+ * the requested proc is done, and destroy 'req' once all parts are, since
+ * each is the cbdata of a PMIx_server_dmodex_request().
+ */
+static void dmodex_request_part_done (struct dmodex *dx,
+                                      struct dmodex_request *req,
+                                      int rank,
+                                      int status)
+{
+    if (rank == req->rank && !req->responded) {
+        req->status = status;
+        dmodex_request_respond (dx, req);
+    }
+    if (--req->pending == 0) {
+        if (!req->responded) {
+            req->status = PMIX_ERR_NOT_FOUND;
+            dmodex_request_respond (dx, req);
+        }
+        dmodex_request_destroy (req);
+    }
+}
+
+/* PMIx_server_dmodex_request() has completed in the pmix server thread.
+ * Pass a copy of the data to the shell thread, which owns the request.
+ */
+static void dmodex_request_cb (pmix_status_t status,
+                               char *data,
+                               size_t size,
+                               void *cbdata)
+{
+    struct dmodex *dx = global_dmodex_ctx;
+    struct dmodex_response *resp;
+
+    if (!(resp = calloc (1, sizeof (*resp) + size)))
+        goto error;
+    resp->part = cbdata;
+    resp->status = status;
+    if (status == PMIX_SUCCESS && size > 0) {
+        memcpy (resp->data, data, size);
+        resp->size = size;
+    }
+    if (interthread_send (dx->it, dx->response_type, resp) < 0)
+        goto error;
+    return;
+error:
+    fprintf (stderr, "error sending dmodex_response interthread message\n");
+    free (resp);
+}
+
+/* Add the data of one requested rank to the pmix-dmodex response.
+ */
+static void dmodex_response_cb (void *rec, void *arg)
+{
+    struct dmodex *dx = arg;
+    struct dmodex_response *resp = rec;
+    struct dmodex_part *part = resp->part;
+    int status = resp->status;
+
+    if (status == PMIX_SUCCESS
+        && !part->req->responded
+        && blobvec_append (part->req->bv,
+                           part->rank,
+                           resp->data,
+                           resp->size) < 0) {
+        shell_warn ("error adding rank %d to pmix-dmodex response",
+                    part->rank);
+        status = PMIX_ERROR;
+    }
+    free (resp);
+    dmodex_request_part_done (dx, part->req, part->rank, status);
+}
+
+/* Another shell requests the data of procs hosted by this shell.
+ */
+static void dmodex_request_msg_cb (flux_t *h,
+                                   flux_msg_handler_t *mh,
+                                   const flux_msg_t *msg,
+                                   void *arg)
+{
+    struct dmodex *dx = arg;
+    const char *nspace;
+    int rank;
+    json_t *ranks;
+    struct dmodex_request *req;
+    size_t index;
+    json_t *o;
+
+    if (flux_request_unpack (msg,
+                             NULL,
+                             "{s:s s:i s:o}",
+                             "nspace", &nspace,
+                             "rank", &rank,
+                             "ranks", &ranks) < 0)
+        goto error;
+    if (!json_is_array (ranks) || json_array_size (ranks) == 0) {
+        errno = EPROTO;
+        goto error;
+    }
+    json_array_foreach (ranks, index, o) {
+        if (!json_is_integer (o)) {
+            errno = EPROTO;
+            goto error;
+        }
+        if (!is_hosted (dx, json_integer_value (o))) {
+            errno = ENOENT;
+            goto error;
+        }
+    }
+    if (!is_hosted (dx, rank)) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (!(req = calloc (1, sizeof (*req)
+                           + json_array_size (ranks) * sizeof (req->parts[0]))))
+        goto error;
+    if (!(req->bv = blobvec_create ())) {
+        dmodex_request_destroy (req);
+        goto error;
+    }
+    req->msg = flux_msg_incref (msg);
+    req->rank = rank;
+    req->count = json_array_size (ranks);
+    req->pending = req->count + 1; // completed below
+    json_array_foreach (ranks, index, o) {
+        struct dmodex_part *part = &req->parts[index];
+        pmix_proc_t proc;
+        int rc;
+
+        part->req = req;
+        part->rank = json_integer_value (o);
+        PMIX_PROC_LOAD (&proc, nspace, part->rank);
+        if ((rc = PMIx_server_dmodex_request (&proc,
+                                              dmodex_request_cb,
+                                              part)) != PMIX_SUCCESS) {
+            shell_warn ("PMIx_server_dmodex_request %s.%d: %s",
+                        nspace,
+                        part->rank,
+                        PMIx_Error_string (rc));
+            dmodex_request_part_done (dx, req, part->rank, rc);
+        }
+    }
+    dmodex_request_part_done (dx, req, -1, PMIX_SUCCESS);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        shell_warn ("error responding to pmix-dmodex request");
+}
+
 int dmodex_server_cb (const pmix_proc_t *proc,
                       const pmix_info_t info[],
                       size_t ninfo,
@@ -142,37 +869,36 @@ int dmodex_server_cb (const pmix_proc_t *proc,
                       void *cbdata)
 {
     struct dmodex *dx = global_dmodex_ctx;
-    json_t *xproc  = NULL;
-    json_t *xinfo = NULL;
-    json_t *xcbfunc = NULL;
-    json_t *xcbdata = NULL;
-    int rc = PMIX_SUCCESS;
+    struct dmodex_call *dxcall;
 
-    if (!(xproc = codec_proc_encode (proc))
-        || !(xinfo = codec_info_array_encode (info, ninfo))
-        || !(xcbfunc = codec_pointer_encode (cbfunc))
-        || !(xcbdata = codec_pointer_encode (cbdata))
-        || interthread_send_pack (dx->it,
-                                  "dmodex_upcall",
-                                  "{s:O s:O s:O s:O}",
-                                  "proc", xproc,
-                                  "info", xinfo,
-                                  "cbfunc", xcbfunc,
-                                  "cbdata", xcbdata) < 0) {
+    if (!cbfunc)
+        return PMIX_ERR_BAD_PARAM;
+    if (!(dxcall = dmodex_call_create (proc, info, ninfo, cbfunc, cbdata))
+        || interthread_send (dx->it, dx->upcall_type, dxcall) < 0) {
         fprintf (stderr, "error sending dmodex_upcall interthread message\n");
-        rc = PMIX_ERROR;
+        dmodex_call_destroy (dxcall);
+        return PMIX_ERROR;
     }
-    json_decref (xproc);
-    json_decref (xinfo);
-    json_decref (xcbfunc);
-    json_decref (xcbdata);
-    return rc;
+    return PMIX_SUCCESS;
 }
 
 void dmodex_destroy (struct dmodex *dx)
 {
     if (dx) {
         int saved_errno = errno;
+        struct dmodex_fetch *fetch;
+        while ((fetch = dx->fetches)) {
+            dx->fetches = fetch->next;
+            dmodex_fetch_destroy (fetch);
+        }
+        for (int i = 0; i < DMODEX_BUCKETS; i++) {
+            struct dmodex_entry *entry;
+            while ((entry = dx->hash[i])) {
+                dx->hash[i] = entry->hnext;
+                dmodex_entry_destroy (entry);
+            }
+        }
+        free (dx->shell_ranks);
         free (dx);
         errno = saved_errno;
         global_dmodex_ctx = NULL;
@@ -182,15 +908,46 @@ void dmodex_destroy (struct dmodex *dx)
 struct dmodex *dmodex_create (flux_shell_t *shell, struct interthread *it)
 {
     struct dmodex *dx;
+    json_int_t cache = 0;
+    int bulk = 0;
 
     if (!(dx = calloc (1, sizeof (*dx))))
         return NULL;
     dx->shell = shell;
     dx->it = it;
-    if (interthread_register (it,
-                              "dmodex_upcall",
-                              dmodex_shell_cb,
-                              dx) < 0)
+    if (flux_shell_getopt_unpack (shell,
+                                  "pmix",
+                                  "{s?{s?I s?i}}",
+                                  "dmodex",
+                                    "cache", &cache,
+                                    "bulk", &bulk) < 0) {
+        shell_warn ("error parsing pmix.dmodex shell options");
+        goto error;
+    }
+    if (cache < 0) {
+        shell_warn ("invalid pmix.dmodex.cache value");
+        errno = EINVAL;
+        goto error;
+    }
+    dx->cache_max = cache;
+    dx->bulk = bulk ? true : false;
+    if (!(dx->taskmap = flux_shell_get_taskmap (shell))
+        || build_shell_ranks (dx) < 0)
+        goto error;
+    if ((dx->upcall_type = interthread_register (it,
+                                                 "dmodex_upcall",
+                                                 dmodex_shell_cb,
+                                                 dx,
+                                                 0)) < 0
+        || (dx->response_type = interthread_register (it,
+                                                      "dmodex_response",
+                                                      dmodex_response_cb,
+                                                      dx,
+                                                      0)) < 0
+        || flux_shell_service_register (shell,
+                                        "pmix-dmodex",
+                                        dmodex_request_msg_cb,
+                                        dx) < 0)
         goto error;
     global_dmodex_ctx = dx;
     return dx;
@@ -20,6 +20,11 @@
 struct dmodex *dmodex_create (flux_shell_t *shell, struct interthread *it);
 void dmodex_destroy (struct dmodex *dx);
 
+/* Drop the data cached from earlier fetches, e.g. once a fence completes,
+ * since procs may have committed new data.
+ */
+void dmodex_cache_clear (struct dmodex *dx);
+
 /* Server direct_modex callback registered with PMIx_server_init().
  */
 int dmodex_server_cb (const pmix_proc_t *proc,
@@ -0,0 +1,254 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* evbcast.c - broadcast exchange results with flux events
+ *
+ * With pmix.exchange.broadcast=event, the gather phase of the exchange
+ * tree uses one-way requests, and rank 0 publishes the result once as a
+ * private Flux event instead of responding down the tree.  Each shell
+ * subscribes to the event, so the broker overlay does the multicast and
+ * interior shells only relay the gather.  Events are delivered to every
+ * broker in the instance, not just those of the job, so this trades
+ * interior shell load for instance-wide traffic.
+ *
+ * Since one-way requests can't return an error, a shell that fails an
+ * exchange publishes an error event instead, and every shell fails that
+ * exchange, now or when it enters it.
+ *
+ * Both events carry a small header naming the exchange and the shell that
+ * published it, followed by the result, if any.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <flux/core.h>
+#include <flux/shell.h>
+
+#include "evbcast.h"
+
+struct evbcast {
+    flux_shell_t *shell;
+    int rank;
+    char *topic;
+    char *error_topic;
+    flux_msg_handler_t *mh;
+    flux_msg_handler_t *error_mh;
+    evbcast_result_f result_cb;
+    evbcast_error_f error_cb;
+    void *arg;
+};
+
+/* Header at the front of each event payload.
+ * Integers are in network byte order.
+ */
+struct evhdr {
+    uint32_t seq;
+    uint32_t rank;                  // publisher shell rank
+    uint32_t stripe;
+};
+
+static void publish_continuation (flux_future_t *f, void *arg)
+{
+    if (flux_future_get (f, NULL) < 0)
+        shell_warn ("error publishing pmix-exchange event: %s",
+                    future_strerror (f, errno));
+    flux_future_destroy (f);
+}
+
+static int publish (struct evbcast *eb,
+                    const char *topic,
+                    uint32_t seq,
+                    uint32_t stripe,
+                    const void *data,
+                    size_t size)
+{
+    flux_t *h = flux_shell_get_flux (eb->shell);
+    struct evhdr hdr = {
+        .seq = htonl (seq),
+        .rank = htonl (eb->rank),
+        .stripe = htonl (stripe),
+    };
+    uint8_t *buf;
+    flux_future_t *f;
+
+    if (!(buf = malloc (sizeof (hdr) + size)))
+        return -1;
+    memcpy (buf, &hdr, sizeof (hdr));
+    if (size > 0)
+        memcpy (buf + sizeof (hdr), data, size);
+    f = flux_event_publish_raw (h,
+                                topic,
+                                FLUX_MSGFLAG_PRIVATE,
+                                buf,
+                                sizeof (hdr) + size);
+    free (buf);
+    if (!f || flux_future_then (f, -1, publish_continuation, NULL) < 0) {
+        flux_future_destroy (f);
+        return -1;
+    }
+    return 0;
+}
+
+int evbcast_publish (struct evbcast *eb,
+                     uint32_t seq,
+                     uint32_t stripe,
+                     const void *data,
+                     size_t size)
+{
+    return publish (eb, eb->topic, seq, stripe, data, size);
+}
+
+int evbcast_publish_error (struct evbcast *eb, uint32_t seq, uint32_t stripe)
+{
+    return publish (eb, eb->error_topic, seq, stripe, NULL, 0);
+}
+
+/* Decode event 'msg'.  Return 1 if it was published by this shell.
+ */
+static int decode (struct evbcast *eb,
+                   const flux_msg_t *msg,
+                   struct evhdr *hdr,
+                   const void **datap,
+                   size_t *sizep)
+{
+    const void *buf;
+    size_t size;
+
+    if (flux_event_decode_raw (msg, NULL, &buf, &size) < 0)
+        return -1;
+    if (size < sizeof (*hdr)) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy (hdr, buf, sizeof (*hdr));
+    hdr->seq = ntohl (hdr->seq);
+    hdr->rank = ntohl (hdr->rank);
+    hdr->stripe = ntohl (hdr->stripe);
+    *sizep = size - sizeof (*hdr);
+    *datap = *sizep > 0 ? (uint8_t *)buf + sizeof (*hdr) : NULL;
+    return hdr->rank == eb->rank ? 1 : 0;
+}
+
+/* the root shell published the result of an exchange.
+ * The root itself completed the exchange when it published, so it ignores
+ * the event.
+ */
+static void result_event_cb (flux_t *h,
+                             flux_msg_handler_t *mh,
+                             const flux_msg_t *msg,
+                             void *arg)
+{
+    struct evbcast *eb = arg;
+    struct evhdr hdr;
+    const void *data;
+    size_t size;
+    int rc;
+
+    if ((rc = decode (eb, msg, &hdr, &data, &size)) < 0) {
+        shell_warn ("error decoding pmix-exchange result event: %s",
+                    strerror (errno));
+        return;
+    }
+    if (rc == 0)
+        eb->result_cb (msg, hdr.seq, hdr.stripe, data, size, eb->arg);
+}
+
+/* a shell published an error for an exchange.
+ * The publisher has already failed it.
+ */
+static void error_event_cb (flux_t *h,
+                            flux_msg_handler_t *mh,
+                            const flux_msg_t *msg,
+                            void *arg)
+{
+    struct evbcast *eb = arg;
+    struct evhdr hdr;
+    const void *data;
+    size_t size;
+    int rc;
+
+    if ((rc = decode (eb, msg, &hdr, &data, &size)) < 0) {
+        shell_warn ("error decoding pmix-exchange error event: %s",
+                    strerror (errno));
+        return;
+    }
+    if (rc == 0)
+        eb->error_cb (hdr.seq, hdr.stripe, hdr.rank, eb->arg);
+}
+
+static flux_msg_handler_t *subscribe (struct evbcast *eb,
+                                      const char *topic,
+                                      flux_msg_handler_f cb)
+{
+    flux_t *h = flux_shell_get_flux (eb->shell);
+    struct flux_match match = FLUX_MATCH_EVENT;
+    flux_msg_handler_t *mh;
+
+    match.topic_glob = (char *)topic;
+    if (!(mh = flux_msg_handler_create (h, match, cb, eb)))
+        return NULL;
+    flux_msg_handler_start (mh);
+    if (flux_event_subscribe (h, topic) < 0) {
+        flux_msg_handler_destroy (mh);
+        return NULL;
+    }
+    return mh;
+}
+
+struct evbcast *evbcast_create (flux_shell_t *shell,
+                                evbcast_result_f result_cb,
+                                evbcast_error_f error_cb,
+                                void *arg)
+{
+    struct evbcast *eb;
+    const char *service;
+
+    if (!(eb = calloc (1, sizeof (*eb))))
+        return NULL;
+    eb->shell = shell;
+    eb->result_cb = result_cb;
+    eb->error_cb = error_cb;
+    eb->arg = arg;
+    if (flux_shell_info_unpack (shell,
+                                "{s:i s:s}",
+                                "rank", &eb->rank,
+                                "service", &service) < 0)
+        goto error;
+    if (asprintf (&eb->topic, "%s.pmix-exchange-result", service) < 0
+        || asprintf (&eb->error_topic, "%s.pmix-exchange-error", service) < 0)
+        goto error;
+    if (!(eb->mh = subscribe (eb, eb->topic, result_event_cb))
+        || !(eb->error_mh = subscribe (eb, eb->error_topic, error_event_cb)))
+        goto error;
+    return eb;
+error:
+    evbcast_destroy (eb);
+    return NULL;
+}
+
+void evbcast_destroy (struct evbcast *eb)
+{
+    if (eb) {
+        int saved_errno = errno;
+        flux_msg_handler_destroy (eb->mh);
+        flux_msg_handler_destroy (eb->error_mh);
+        free (eb->topic);
+        free (eb->error_topic);
+        free (eb);
+        errno = saved_errno;
+    }
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,60 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_EVBCAST_H
+#define _PX_EVBCAST_H
+
+#include <stdint.h>
+#include <flux/core.h>
+#include <flux/shell.h>
+
+/* A result event for exchange 'seq' (stripe 'stripe') arrived.
+ * 'data' points into 'msg', which may be kept with flux_msg_incref().
+ * An empty result is NULL.
+ */
+typedef void (*evbcast_result_f)(const flux_msg_t *msg,
+                                 uint32_t seq,
+                                 uint32_t stripe,
+                                 const void *data,
+                                 size_t size,
+                                 void *arg);
+
+/* Shell 'rank' published an error for exchange 'seq' (stripe 'stripe').
+ */
+typedef void (*evbcast_error_f)(uint32_t seq,
+                                uint32_t stripe,
+                                uint32_t rank,
+                                void *arg);
+
+/* Subscribe to the result and error events of this job.
+ * Events published by this shell are not passed to the callbacks.
+ */
+struct evbcast *evbcast_create (flux_shell_t *shell,
+                                evbcast_result_f result_cb,
+                                evbcast_error_f error_cb,
+                                void *arg);
+void evbcast_destroy (struct evbcast *eb);
+
+/* Publish the result of exchange 'seq' (stripe 'stripe') to all shells.
+ */
+int evbcast_publish (struct evbcast *eb,
+                     uint32_t seq,
+                     uint32_t stripe,
+                     const void *data,
+                     size_t size);
+
+/* Publish an error for exchange 'seq' (stripe 'stripe'), so that shells
+ * waiting on the result event fail instead of hanging.
+ */
+int evbcast_publish_error (struct evbcast *eb, uint32_t seq, uint32_t stripe);
+
+#endif // _PX_EVBCAST_H
+
+// vi:ts=4 sw=4 expandtab
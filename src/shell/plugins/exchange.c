@@ -12,76 +12,235 @@
  *
  * Derived from shell/pmi/pmi_exchange.c in flux-core.
  *
- * This version concatenates json arrays of base64 strings (in random order)
+ * This version concatenates opaque data blobs (in random order)
  * instead of merging json dictionaries, to fit the pmix fence data model.
- * In addition, the interfaces are made more convenient for use by pmix
- * callbacks: entry function takes a json base64 string, while exit callback
- * accessor gets the fully decoded, concatenated blob.
+ * Blobs are gathered as length-prefixed segments in the raw payload of
+ * pmix-exchange requests (see blobvec.h), so there is no base64 or json
+ * encoding on the exchange path.  Rank 0 appends the segment data to one
+ * contiguous buffer as requests arrive, and that buffer is the result
+ * that is sent back down.  Thus each shell receives the concatenated blob
+ * in the layout pmix consumes, and the exit callback accessor lends it,
+ * in the message or buffer that holds it, without another pass over the
+ * data.
+ *
+ * If the pmix.exchange.chunk-size shell option is set, the broadcast
+ * phase is pipelined: pmix-exchange requests are sent as streaming RPCs,
+ * and the result is returned in chunks of that size, terminated by
+ * ENODATA.  Each shell relays chunks to its children as soon as they
+ * arrive from its parent, instead of waiting for the whole result.
+ *
+ * Multiple exchanges may be in progress at once.  Each is identified by
+ * a sequence number supplied by the caller, which must be the same on
+ * all shells, e.g. the fence sequence.  The sequence number is carried in
+ * a small header at the front of each pmix-exchange request payload.
+ *
+ * The tree is one of several exchange algorithms.  The
+ * pmix.exchange.algorithm shell option selects the algorithm for
+ * exchanges that collect data, and pmix.exchange.barrier selects the
+ * algorithm for exchanges that don't, e.g. fences without pmix.collect.
+ * The caller says which kind each exchange is, rather than leaving it to
+ * whether this shell has data, so that all shells make the same choice.
+ * The peer to peer algorithms are implemented in allgather.c.
+ *
+ * An exchange without data is a barrier.  On the tree, it carries only
+ * the header and empty responses, so no data buffers are allocated.
+ *
+ * The tree fanout is set by the pmix.exchange.fanout shell option.  If it
+ * is "auto", the first tree exchange runs with a fanout based on the job
+ * size while rank 0 measures the per-hop RPC latency (a ping to rank 1)
+ * and the time it spends handling each child request.  Rank 0 then picks
+ * the fanout that minimizes the modeled exchange time and appends it to
+ * the result as a reserved segment.  Each shell switches to the new
+ * fanout when that exchange completes.  Other tree exchanges entered in
+ * the meantime are deferred until then, so all shells agree on the tree
+ * for every sequence number.  If it is "topology", the tree follows the
+ * broker overlay, which every shell fetches from broker rank 0 at startup,
+ * failing if it can't, so that no shell falls back to a different tree.
+ * pmix.exchange.balance places shells by task count instead.  The tree
+ * shapes are computed in tree.c.
+ *
+ * Other shell options change how data moves on the tree:
+ *
+ * broadcast=event
+ *   Children send one-way requests, and rank 0 publishes the result as
+ *   an event (see evbcast.c).  Excludes chunk-size.
+ *
+ * compress
+ *   Tree contributions of at least that many bytes are compressed with
+ *   zlib (see zcodec.h) if that saves at least 1/8 of their size, or else
+ *   compression is skipped for the next few exchanges.  Compressed
+ *   segments are flagged in the segment id, passed up the tree as is,
+ *   and uncompressed by rank 0 directly into the result buffer.
+ *
+ * delta
+ *   Unchanged subtree data is sent by reference to the earlier exchange
+ *   that carried it (see delta.h).  Likewise for the broadcast, each
+ *   shell names the last result it received in its request, and the
+ *   parent responds with just that sequence number if the new result is
+ *   the same.  The broadcast is not delta encoded with chunk-size or
+ *   broadcast=event.
+ *
+ * stripes
+ *   With N > 1, each contribution is split into N pieces, and piece j is
+ *   exchanged over a k-ary tree rooted at shell j*size/N, so the load is
+ *   spread over N roots.  Every shell reassembles each contribution from
+ *   its pieces in stripe order.  Excludes autotune, compress, delta, and
+ *   balance.
  */
 
 #if HAVE_CONFIG_H
 #include "config.h"
 #endif
 #include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
 #include <jansson.h>
 #include <flux/core.h>
 #include <flux/shell.h>
 
-#include "codec.h"
+#include "blobvec.h"
+#include "zcodec.h"
+#include "allgather.h"
+#include "delta.h"
+#include "evbcast.h"
+#include "brokermap.h"
+#include "tree.h"
 
 #include "exchange.h"
 
-#define DEFAULT_TREE_K 2
+#define ALGO_TREE 0
+
+/* Segment id flag for compressed segments.  Never part of a shell rank.
+ */
+#define ZSEG_FLAG (1U << 31)
+
+/* Exchanges to skip compression for after it failed to pay off.
+ */
+#define COMPRESS_BACKOFF 8
 
 struct session {
-    json_t *data_in;                // arrays of gathered base64 strings
-    json_t *data_out;
+    uint32_t seq;                   // exchange sequence number
+    struct blobvec *data_in;        // gathered segments (NULL if none)
+    const void *data_out;           // result (NULL if empty)
+    size_t data_out_size;
+    const flux_msg_t *msg;          // message that data_out points into
     exchange_exit_f exit_cb;        // callback for exchange completion
     void *exit_cb_arg;
 
     struct flux_msglist *requests;  // pending requests from children
     flux_future_t *f;               // pending request to parent
+    bool sent;                      // request was sent to parent
+    uint32_t base;                  // data_in was sent by reference to this
+    bool parent_done;               // final response (or event) received
+
+    uint32_t stripe;                // stripe number (XHDR_NOSTRIPE if none)
+    uint32_t root;                  // shell rank at the root of the tree
+    uint32_t parent_nodeid;         // stripe only: broker rank of parent
+    int child_count;                // stripe only: number of children
+    struct blobvec **stripes;       // whole exchange: results by stripe
+    int stripes_pending;
+
+    uint8_t *buf;                   // result, accumulated (rank 0, streamed)
+    size_t buf_size;
+    size_t buf_length;              // allocated size of buf
+    bool relayed;                   // chunks were relayed to children
 
     struct exchange *xcg;
+    int algo;                       // algorithm used by this exchange
     bool local;                     // exchange() was called on this shell
+    struct xresult *rpin;           // delta: cached result named in request
+    struct xresult *result;         // holds data_out, once lent
+    int rsame;                      // delta: data_out equals xcg->rcache
+                                    //   (-1 if not compared yet)
+    uint8_t *rbuf;                  // delta: result with response header
     bool has_error;                 // an error occurred
+    bool error_sent;                // error event was published or received
+
+    struct session *next;
 };
 
 struct exchange {
     flux_shell_t *shell;
     int size;
     int rank;
+    int k;                          // tree fanout (0=overlay topology)
     uint32_t parent_rank;
+    uint32_t parent_nodeid;         // broker rank of parent shell
     int child_count;
+    char *topic;                    // shell service topic for pmix-exchange
+    size_t chunk_size;              // streaming chunk size (0=disabled)
+    struct evbcast *evb;            // broadcast result with a flux event
+    int algo;                       // algorithm for exchanges with data
+    int barrier_algo;               // algorithm for exchanges without data
+    struct allgather *ag;
+    struct brokermap *brokermap;    // broker rank by shell rank
+    size_t compress_min;            // compress contributions >= this (0=off)
+    int compress_skip;              // exchanges left to skip compression
+    struct delta *delta;            // refer to unchanged data by sequence
+    struct xresult *rcache;         // last exchange result received
+    int stripes;                    // number of stripes (1=not striped)
+    bool balance;                   // place shells by task count
+
+    bool tuning;                    // fanout autotune is in progress
+    bool tune_started;              // tune_seq is valid
+    uint32_t tune_seq;              // exchange used to measure
+    char *ping_topic;
+    flux_future_t *ping_f;          // rank 0: latency probe to rank 1
+    double ping_start;
+    double hop_latency;             // rank 0: probe result (< 0 if none yet)
+    double msg_time;                // rank 0: total child request handling
+    int msg_count;
 
-    struct session *session;
+    struct session *sessions;       // exchanges in progress
+    struct session *current;        // session in exit callback
 };
 
-static void exchange_response_completion (flux_future_t *f, void *arg);
+/* Header at the front of each pmix-exchange request payload.
+ * Integers are in network byte order.
+ */
+struct xhdr {
+    uint32_t seq;
+    uint32_t rank;                  // sender shell rank
+    uint32_t base;                  // data is the same as in exchange 'base'
+    uint32_t stripe;                // stripe of a striped exchange
+    uint32_t rbase;                 // sender has result of exchange 'rbase'
+};
+
+#define XHDR_NOBASE (~(uint32_t)0)
+#define XHDR_NOSTRIPE (~(uint32_t)0)
 
-/* borrow a couple of well tested functions from kary.c in flux-core
+/* A cached exchange result, which points into a message or owns a buffer.
  */
-#define KARY_NONE   (~(uint32_t)0)
-// Return the parent of i or KARY_NONE if i has no parent.
-static uint32_t kary_parentof (int k, uint32_t i)
+struct xresult {
+    int refcount;
+    uint32_t seq;
+    const void *data;
+    size_t size;
+    const flux_msg_t *msg;
+    void *buf;
+};
+
+static void exchange_response_completion (flux_future_t *f, void *arg);
+static void publish_error (struct exchange *xcg,
+                           uint32_t seq,
+                           uint32_t stripe);
+
+static struct xresult *xresult_incref (struct xresult *xr)
 {
-    if (i == 0 || k <= 0)
-        return KARY_NONE;
-    if (k == 1)
-        return i - 1;
-    return (k + (i + 1) - 2) / k - 1;
+    if (xr)
+        xr->refcount++;
+    return xr;
 }
-// Return the jth child of i or KARY_NONE if i has no such child.
-static uint32_t kary_childof (int k, uint32_t size, uint32_t i, int j)
-{
-    uint32_t n;
 
-    if (k > 0 && j >= 0 && j < k) {
-        n = k*(i + 1) - (k - 2) + j - 1;
-        if (n < size)
-            return n;
+static void xresult_decref (struct xresult *xr)
+{
+    if (xr && --xr->refcount == 0) {
+        int saved_errno = errno;
+        flux_msg_decref (xr->msg);
+        free (xr->buf);
+        free (xr);
+        errno = saved_errno;
     }
-    return KARY_NONE;
 }
 
 static void session_destroy (struct session *ses)
@@ -90,81 +249,806 @@ static void session_destroy (struct session *ses)
         int saved_errno = errno;
         flux_msglist_destroy (ses->requests);
         flux_future_destroy (ses->f);
-        json_decref (ses->data_in);
-        json_decref (ses->data_out);
+        blobvec_destroy (ses->data_in);
+        flux_msg_decref (ses->msg);
+        free (ses->buf);
+        xresult_decref (ses->rpin);
+        xresult_decref (ses->result);
+        free (ses->rbuf);
+        if (ses->stripes) {
+            for (int i = 0; i < ses->xcg->stripes; i++)
+                blobvec_destroy (ses->stripes[i]);
+            free (ses->stripes);
+        }
         free (ses);
         errno = saved_errno;
     }
 }
 
-static struct session *session_create (struct exchange *xcg)
+static uint32_t stripe_root (struct exchange *xcg, uint32_t stripe)
+{
+    return (uint64_t)stripe * xcg->size / xcg->stripes;
+}
+
+/* Place this shell in the k-ary tree of 'stripe', which is the tree of
+ * rank 0 with shell ranks rotated so that the stripe root is at the top.
+ */
+static int stripe_tree (struct session *ses, uint32_t stripe)
+{
+    struct exchange *xcg = ses->xcg;
+    int k = xcg->k > 0 ? xcg->k : TREE_DEFAULT_K;
+    uint32_t vrank;
+    uint32_t parent;
+    int broker_rank = 0;
+
+    if (stripe >= xcg->stripes) {
+        errno = EPROTO;
+        return -1;
+    }
+    ses->root = stripe_root (xcg, stripe);
+    vrank = (xcg->rank - ses->root + xcg->size) % xcg->size;
+    if ((parent = tree_kary_parent (k, vrank)) != TREE_NONE) {
+        broker_rank = brokermap_lookup (xcg->brokermap,
+                                        (parent + ses->root) % xcg->size);
+        if (broker_rank < 0)
+            return -1;
+    }
+    ses->stripe = stripe;
+    ses->parent_nodeid = broker_rank;
+    ses->child_count = tree_kary_child_count (k, xcg->size, vrank);
+    return 0;
+}
+
+static struct session *session_create (struct exchange *xcg,
+                                       uint32_t seq,
+                                       uint32_t stripe)
 {
     struct session *ses;
 
     if (!(ses = calloc (1, sizeof (*ses))))
         return NULL;
     ses->xcg = xcg;
+    ses->seq = seq;
+    ses->base = XHDR_NOBASE;
+    ses->stripe = XHDR_NOSTRIPE;
+    ses->rsame = -1;
     if (!(ses->requests = flux_msglist_create ()))
         goto error;
-    if (!(ses->data_in = json_array ())) {
-        errno = ENOMEM;
+    if (stripe != XHDR_NOSTRIPE && stripe_tree (ses, stripe) < 0)
         goto error;
-    }
     return ses;
 error:
     session_destroy (ses);
     return NULL;
 }
 
-static void session_process (struct session *ses)
+static struct session *session_find (struct exchange *xcg,
+                                     uint32_t seq,
+                                     uint32_t stripe)
+{
+    struct session *ses;
+
+    for (ses = xcg->sessions; ses != NULL; ses = ses->next) {
+        if (ses->seq == seq && ses->stripe == stripe)
+            return ses;
+    }
+    return NULL;
+}
+
+/* Find session 'seq' (stripe 'stripe'), creating it if it doesn't exist.
+ */
+static struct session *session_lookup (struct exchange *xcg,
+                                       uint32_t seq,
+                                       uint32_t stripe)
+{
+    struct session *ses;
+
+    if ((ses = session_find (xcg, seq, stripe)))
+        return ses;
+    if (!(ses = session_create (xcg, seq, stripe)))
+        return NULL;
+    ses->next = xcg->sessions;
+    xcg->sessions = ses;
+    return ses;
+}
+
+static void session_unlink (struct exchange *xcg, struct session *ses)
+{
+    struct session **sp;
+
+    for (sp = &xcg->sessions; *sp != NULL; sp = &(*sp)->next) {
+        if (*sp == ses) {
+            *sp = ses->next;
+            break;
+        }
+    }
+}
+
+static bool is_root (struct session *ses)
+{
+    return ses->xcg->rank == ses->root;
+}
+
+static int ses_child_count (struct session *ses)
+{
+    if (ses->stripe != XHDR_NOSTRIPE)
+        return ses->child_count;
+    return ses->xcg->child_count;
+}
+
+static uint32_t ses_parent_nodeid (struct session *ses)
+{
+    if (ses->stripe != XHDR_NOSTRIPE)
+        return ses->parent_nodeid;
+    return ses->xcg->parent_nodeid;
+}
+
+static void msg_decref (void *arg)
+{
+    flux_msg_decref (arg);
+}
+
+/* The broadcast is delta encoded on the tree, if responses aren't
+ * streamed.
+ */
+static bool rdelta (struct exchange *xcg)
+{
+    return xcg->delta && !xcg->evb && xcg->chunk_size == 0;
+}
+
+static double now (struct exchange *xcg)
+{
+    flux_reactor_t *r = flux_get_reactor (flux_shell_get_flux (xcg->shell));
+
+    flux_reactor_now_update (r);
+    return flux_reactor_now (r);
+}
+
+/* Look up 'key' in the rank info of every shell.
+ * The caller must free the returned array.
+ */
+static int *rank_info_array (struct exchange *xcg, const char *key)
+{
+    int *a;
+
+    if (!(a = calloc (xcg->size, sizeof (a[0]))))
+        return NULL;
+    for (int i = 0; i < xcg->size; i++) {
+        if (flux_shell_rank_info_unpack (xcg->shell,
+                                         i,
+                                         "{s:i}",
+                                         key, &a[i]) < 0) {
+            int saved_errno = errno;
+            free (a);
+            errno = saved_errno;
+            return NULL;
+        }
+    }
+    return a;
+}
+
+/* Set the tree fanout and recompute this shell's place in the tree.
+ */
+static int set_fanout (struct exchange *xcg, int k)
+{
+    uint32_t parent_rank = tree_kary_parent (k, xcg->rank);
+    int count = tree_kary_child_count (k, xcg->size, xcg->rank);
+    int broker_rank = 0;
+
+    if (xcg->balance) {
+        int *ntasks;
+        int rc;
+
+        if (!(ntasks = rank_info_array (xcg, "ntasks")))
+            return -1;
+        rc = tree_balanced (k,
+                            xcg->size,
+                            ntasks,
+                            xcg->rank,
+                            &parent_rank,
+                            &count);
+        free (ntasks);
+        if (rc < 0)
+            return -1;
+    }
+    if (parent_rank != TREE_NONE) {
+        if ((broker_rank = brokermap_lookup (xcg->brokermap, parent_rank)) < 0)
+            return -1;
+    }
+    xcg->k = k;
+    xcg->parent_rank = parent_rank;
+    xcg->parent_nodeid = broker_rank;
+    xcg->child_count = count;
+    if (xcg->delta)
+        delta_reset (xcg->delta);
+    return 0;
+}
+
+/* Derive this shell's place in the tree from the broker overlay topology.
+ * Only broker rank 0 knows the whole topology, so ask it.
+ */
+static int set_topology (struct exchange *xcg)
+{
+    flux_t *h = flux_shell_get_flux (xcg->shell);
+    flux_future_t *f = NULL;
+    json_t *topo;
+    const int *brokers;
+    uint32_t parent_rank;
+    int count;
+    int saved_errno;
+    int rc = -1;
+
+    if (!(brokers = brokermap_array (xcg->brokermap)))
+        return -1;
+    if (!(f = flux_rpc_pack (h,
+                             "overlay.topology",
+                             0,
+                             0,
+                             "{s:i}",
+                             "rank", 0))
+        || flux_rpc_get_unpack (f, "o", &topo) < 0
+        || tree_topology (topo,
+                          xcg->size,
+                          brokers,
+                          xcg->rank,
+                          &parent_rank,
+                          &count) < 0)
+        goto done;
+    xcg->k = 0;
+    xcg->parent_rank = parent_rank;
+    xcg->parent_nodeid = parent_rank != TREE_NONE ? brokers[parent_rank] : 0;
+    xcg->child_count = count;
+    rc = 0;
+done:
+    saved_errno = errno;
+    flux_future_destroy (f);
+    errno = saved_errno;
+    return rc;
+}
+
+/* The tuning exchange is complete.  Remove the fanout appended by rank 0
+ * to the end of the result and switch to that fanout.
+ */
+static void autotune_finish (struct exchange *xcg, struct session *ses)
+{
+    uint32_t k;
+
+    xcg->tuning = false;
+    if (ses->has_error)
+        return;
+    if (ses->data_out_size < sizeof (k)) {
+        errno = EPROTO;
+        goto error;
+    }
+    ses->data_out_size -= sizeof (k);
+    memcpy (&k, (uint8_t *)ses->data_out + ses->data_out_size, sizeof (k));
+    k = ntohl (k);
+    if (ses->data_out_size == 0)
+        ses->data_out = NULL;
+    if (k < 1 || k > xcg->size) {
+        errno = EPROTO;
+        goto error;
+    }
+    if (k != xcg->k && set_fanout (xcg, k) < 0)
+        goto error;
+    if (xcg->rank == 0)
+        shell_debug ("autotune: using k=%d", xcg->k);
+    return;
+error:
+    shell_warn ("error applying exchange fanout autotune: %s",
+                strerror (errno));
+    ses->has_error = 1;
+}
+
+/* Append 'size' bytes to the result buffer.
+ * If 'data' is NULL, the space is reserved but not filled.
+ */
+static int buf_append (struct session *ses, const void *data, size_t size)
+{
+    if (ses->buf_size + size > ses->buf_length) {
+        size_t new_length = ses->buf_length ? ses->buf_length : size;
+        uint8_t *new_buf;
+
+        while (new_length < ses->buf_size + size)
+            new_length *= 2;
+        if (!(new_buf = realloc (ses->buf, new_length)))
+            return -1;
+        ses->buf = new_buf;
+        ses->buf_length = new_length;
+    }
+    if (size > 0 && data)
+        memcpy (ses->buf + ses->buf_size, data, size);
+    ses->buf_size += size;
+    return 0;
+}
+
+/* Rank 0: uncompress a compressed segment onto the end of the result buffer.
+ */
+static int buf_uncompress (struct session *ses, const void *zdata, size_t zsize)
+{
+    size_t size;
+
+    if (zcodec_size (zdata, zsize, &size) < 0
+        || buf_append (ses, NULL, size) < 0)
+        return -1;
+    if (zcodec_uncompress (zdata,
+                           zsize,
+                           ses->buf + ses->buf_size - size,
+                           size) < 0) {
+        ses->buf_size -= size;
+        return -1;
+    }
+    return 0;
+}
+
+/* Rank 0: append the segment data of 'bv' to the result buffer,
+ * without framing.
+ */
+static int buf_extend_blobvec (struct session *ses, struct blobvec *bv)
+{
+    const void *seg;
+    uint32_t id;
+    size_t segsize;
+
+    seg = blobvec_first (bv, &id, &segsize);
+    while (seg) {
+        if ((id & ZSEG_FLAG)) {
+            if (buf_uncompress (ses, seg, segsize) < 0)
+                return -1;
+        }
+        else if (buf_append (ses, seg, segsize) < 0)
+            return -1;
+        seg = blobvec_next (bv, &id, &segsize);
+    }
+    return 0;
+}
+
+/* Rank 0: append the segment data of child request 'msg' to the result
+ * buffer.
+ */
+static int buf_extend (struct session *ses,
+                       const flux_msg_t *msg,
+                       const void *data,
+                       size_t size)
+{
+    struct blobvec *bv;
+    int rc;
+
+    if (!(bv = blobvec_wrap (data, size, msg_decref, (void *)msg)))
+        return -1;
+    flux_msg_incref (msg);
+    rc = buf_extend_blobvec (ses, bv);
+    blobvec_destroy (bv);
+    return rc;
+}
+
+/* Non-root: append the segments of a child request to data_in.
+ */
+static int data_in_extend (struct session *ses, const void *data, size_t size)
+{
+    if (!ses->data_in && !(ses->data_in = blobvec_create ()))
+        return -1;
+    return blobvec_extend (ses->data_in, data, size);
+}
+
+/* Rank 0: choose the fanout and append it to the tuning exchange result.
+ */
+static int autotune_append (struct exchange *xcg, struct session *ses)
+{
+    double msgcost = xcg->msg_count > 0 ? xcg->msg_time / xcg->msg_count : 0;
+    int k = tree_autotune_fanout (xcg->size, xcg->hop_latency, msgcost);
+    uint32_t n = htonl (k);
+
+    shell_debug ("autotune: latency=%.3fms msgcost=%.3fms size=%d: k=%d",
+                 xcg->hop_latency * 1E3,
+                 msgcost * 1E3,
+                 xcg->size,
+                 k);
+    return buf_append (ses, &n, sizeof (n));
+}
+
+static void session_process (struct session *ses);
+
+/* Process tree exchanges that were deferred during autotune.
+ */
+static void autotune_resume (struct exchange *xcg)
+{
+    struct session *ses = xcg->sessions;
+
+    while (ses) {
+        struct session *next = ses->next;
+        if (ses->local && ses->algo == ALGO_TREE)
+            session_process (ses);
+        ses = next;
+    }
+}
+
+/* Return true if the result of 'ses' is the same as the cached result.
+ */
+static bool result_same (struct session *ses)
+{
+    struct xresult *xr = ses->xcg->rcache;
+
+    if (ses->rsame < 0) {
+        ses->rsame = xr
+                     && ses->data_out
+                     && xr->size == ses->data_out_size
+                     && (xr->data == ses->data_out
+                         || !memcmp (xr->data, ses->data_out, xr->size));
+    }
+    return ses->rsame;
+}
+
+/* Get the result of 'ses' (data_out) as an xresult, which takes over the
+ * message or buffer that holds it.
+ */
+static struct xresult *session_result (struct session *ses)
+{
+    struct xresult *xr;
+
+    if (ses->result)
+        return ses->result;
+    if (ses->rpin && ses->data_out == ses->rpin->data)
+        return (ses->result = xresult_incref (ses->rpin));
+    if (!(xr = calloc (1, sizeof (*xr))))
+        return NULL;
+    xr->refcount = 1;
+    xr->seq = ses->seq;
+    xr->data = ses->data_out;
+    xr->size = ses->data_out_size;
+    if (ses->data_out == ses->buf) {
+        xr->buf = ses->buf;
+        ses->buf = NULL;
+    }
+    else
+        xr->msg = flux_msg_incref (ses->msg);
+    return (ses->result = xr);
+}
+
+/* Cache the result of 'ses', unless it is the same as the cached result,
+ * in which case the earlier sequence number, which children may have,
+ * continues to name it.
+ */
+static void result_cache (struct session *ses)
+{
+    struct exchange *xcg = ses->xcg;
+    struct xresult *xr;
+
+    if (!ses->data_out || result_same (ses) || !(xr = session_result (ses)))
+        return;
+    xresult_decref (xcg->rcache);
+    xcg->rcache = xresult_incref (xr);
+}
+
+/* Notify the caller that exchange 'ses' is complete, and destroy it.
+ */
+static void session_finish (struct session *ses)
 {
     struct exchange *xcg = ses->xcg;
+    bool tuned = false;
+
+    if (xcg->tuning && xcg->tune_started && ses->seq == xcg->tune_seq) {
+        autotune_finish (xcg, ses);
+        tuned = true;
+    }
+    if (ses->has_error) {
+        if (xcg->delta)
+            delta_reset (xcg->delta);
+        if (xcg->evb && !ses->error_sent)
+            publish_error (xcg, ses->seq, ses->stripe);
+    }
+    else if (rdelta (xcg)
+             && !tuned
+             && ses->algo == ALGO_TREE
+             && ses->stripe == XHDR_NOSTRIPE)
+        result_cache (ses);
+    session_unlink (xcg, ses);
+    xcg->current = ses;
+    ses->exit_cb (xcg, ses->exit_cb_arg);
+    xcg->current = NULL;
+    session_destroy (ses);
+    if (tuned)
+        autotune_resume (xcg);
+}
+
+/* Rank 0: the latency probe to rank 1 has completed.
+ */
+static void ping_continuation (flux_future_t *f, void *arg)
+{
+    struct exchange *xcg = arg;
+    struct session *ses;
+
+    if (flux_future_get (f, NULL) < 0) {
+        shell_warn ("pmix-exchange-ping: %s", future_strerror (f, errno));
+        xcg->hop_latency = 0;
+    }
+    else
+        xcg->hop_latency = (now (xcg) - xcg->ping_start) / 2;
+    if ((ses = session_find (xcg, xcg->tune_seq, XHDR_NOSTRIPE)))
+        session_process (ses);
+}
+
+/* Rank 0: measure per-hop RPC latency with a ping to rank 1.
+ */
+static int ping_start (struct exchange *xcg)
+{
+    flux_t *h = flux_shell_get_flux (xcg->shell);
+    int broker_rank;
+
+    if ((broker_rank = brokermap_lookup (xcg->brokermap, 1)) < 0)
+        return -1;
+    xcg->ping_start = now (xcg);
+    if (!(xcg->ping_f = flux_rpc_raw (h,
+                                      xcg->ping_topic,
+                                      NULL,
+                                      0,
+                                      broker_rank,
+                                      0))
+        || flux_future_then (xcg->ping_f, -1, ping_continuation, xcg) < 0)
+        return -1;
+    return 0;
+}
+
+/* Send pmix-exchange request with header and data_in to the parent shell.
+ */
+static flux_future_t *send_request (struct session *ses)
+{
+    struct exchange *xcg = ses->xcg;
+    flux_t *h = flux_shell_get_flux (xcg->shell);
+    int flags = 0;
+    struct xhdr hdr = {
+        .seq = htonl (ses->seq),
+        .rank = htonl (xcg->rank),
+        .base = htonl (ses->base),
+        .stripe = htonl (ses->stripe),
+        .rbase = htonl (XHDR_NOBASE),
+    };
+    const void *data;
+    size_t size;
+    uint8_t *buf;
+    flux_future_t *f;
+
+    if (rdelta (xcg)) {
+        if (!ses->rpin)
+            ses->rpin = xresult_incref (xcg->rcache);
+        if (ses->rpin)
+            hdr.rbase = htonl (ses->rpin->seq);
+    }
+    if (xcg->evb)
+        flags = FLUX_RPC_NORESPONSE;
+    else if (xcg->chunk_size > 0)
+        flags = FLUX_RPC_STREAMING;
+    if (!ses->data_in || ses->base != XHDR_NOBASE) {
+        return flux_rpc_raw (h,
+                             xcg->topic,
+                             &hdr,
+                             sizeof (hdr),
+                             ses_parent_nodeid (ses),
+                             flags);
+    }
+    if (blobvec_encode (ses->data_in, &data, &size) < 0
+        || !(buf = malloc (sizeof (hdr) + size)))
+        return NULL;
+    memcpy (buf, &hdr, sizeof (hdr));
+    if (size > 0)
+        memcpy (buf + sizeof (hdr), data, size);
+    f = flux_rpc_raw (h,
+                      xcg->topic,
+                      buf,
+                      sizeof (hdr) + size,
+                      ses_parent_nodeid (ses),
+                      flags);
+    free (buf);
+    return f;
+}
+
+static void publish_error (struct exchange *xcg,
+                           uint32_t seq,
+                           uint32_t stripe)
+{
+    if (evbcast_publish_error (xcg->evb, seq, stripe) < 0)
+        shell_warn ("error publishing pmix-exchange error: %s",
+                    strerror (errno));
+}
+
+/* Respond to child request 'msg' with the complete result.
+ * A streaming request gets the result in chunks followed by ENODATA,
+ * or just ENODATA if the chunks were already relayed as they arrived.
+ */
+static int respond_data (struct session *ses,
+                         const flux_msg_t *msg,
+                         const void *buf,
+                         size_t size)
+{
     flux_t *h = flux_shell_get_flux (ses->xcg->shell);
+
+    if (!flux_msg_is_streaming (msg))
+        return flux_respond_raw (h, msg, buf, size);
+    if (!ses->relayed) {
+        size_t chunk_size = ses->xcg->chunk_size;
+        size_t offset = 0;
+
+        if (chunk_size == 0)
+            chunk_size = size;
+        while (offset < size) {
+            size_t len = size - offset;
+            if (len > chunk_size)
+                len = chunk_size;
+            if (flux_respond_raw (h, msg, (uint8_t *)buf + offset, len) < 0)
+                return -1;
+            offset += len;
+        }
+    }
+    return flux_respond_error (h, msg, ENODATA, NULL);
+}
+
+/* Respond to child request 'msg' with a header naming the exchange that
+ * had the same result, if the child has it cached.  Otherwise respond
+ * with a header and the complete result.
+ */
+static int respond_delta (struct session *ses, const flux_msg_t *msg)
+{
+    struct exchange *xcg = ses->xcg;
+    flux_t *h = flux_shell_get_flux (xcg->shell);
+    uint32_t base = htonl (XHDR_NOBASE);
+    const void *buf;
+    size_t size;
+    struct xhdr hdr;
+
+    if (flux_request_decode_raw (msg, NULL, &buf, &size) < 0)
+        return -1;
+    memcpy (&hdr, buf, sizeof (hdr)); // size was checked on receipt
+    if (xcg->rcache
+        && ntohl (hdr.rbase) == xcg->rcache->seq
+        && result_same (ses))
+        return flux_respond_raw (h, msg, &hdr.rbase, sizeof (hdr.rbase));
+    if (!ses->rbuf) {
+        if (!(ses->rbuf = malloc (sizeof (base) + ses->data_out_size)))
+            return -1;
+        memcpy (ses->rbuf, &base, sizeof (base));
+        if (ses->data_out_size > 0)
+            memcpy (ses->rbuf + sizeof (base),
+                    ses->data_out,
+                    ses->data_out_size);
+    }
+    return flux_respond_raw (h,
+                             msg,
+                             ses->rbuf,
+                             sizeof (base) + ses->data_out_size);
+}
+
+/* Non-root: send data_in by reference if it is the same as the data last
+ * sent in full.  Otherwise remember it for next time.
+ * N.B. the tree may change during autotune, so don't refer to earlier
+ * data then.
+ */
+static void session_delta_check (struct session *ses)
+{
+    struct exchange *xcg = ses->xcg;
+
+    if (!ses->data_in || xcg->tuning)
+        return;
+    delta_check (xcg->delta, ses->seq, ses->data_in, &ses->base);
+}
+
+static void session_process (struct session *ses)
+{
+    struct exchange *xcg = ses->xcg;
     const flux_msg_t *msg;
 
-    if (ses->has_error)
+    /* A session that failed before this shell entered it (see
+     * exchange_error_event_cb) fails when it does.
+     */
+    if (ses->has_error) {
+        if (!ses->local)
+            return;
         goto done;
+    }
+
+    /* Only the tuning exchange may use the tree during autotune.
+     */
+    if (xcg->tuning && (!xcg->tune_started || ses->seq != xcg->tune_seq))
+        return;
 
     /* Awaiting self or child input?
      */
-    if (!ses->local || flux_msglist_count (ses->requests) < xcg->child_count)
+    if (!ses->local
+        || flux_msglist_count (ses->requests) < ses_child_count (ses))
         return;
 
     /* Send exchange request, if needed.
      */
-    if (xcg->rank > 0 && !ses->f) {
+    if (!is_root (ses) && !ses->sent) {
         flux_future_t *f;
 
-        if (!(f = flux_shell_rpc_pack (xcg->shell,
-                                       "pmix-exchange",
-                                       xcg->parent_rank,
-                                       0,
-                                       "{s:O}",
-                                       "data", ses->data_in))
-                || flux_future_then (f,
-                                     -1,
-                                     exchange_response_completion,
-                                     xcg) < 0) {
+        if (xcg->delta)
+            session_delta_check (ses);
+        if (!(f = send_request (ses))
+                || (!xcg->evb
+                    && flux_future_then (f,
+                                         -1,
+                                         exchange_response_completion,
+                                         ses) < 0)) {
             flux_future_destroy (f);
             shell_warn ("error sending pmix-exchange request");
             ses->has_error = 1;
             goto done;
         }
-        ses->f = f;
+        if (xcg->evb)
+            flux_future_destroy (f); // one-way request
+        else
+            ses->f = f;
+        ses->sent = true;
     }
 
-    /* Awaiting parent response?
+    /* Awaiting parent response or result event?
      */
-    if (ses->f && !flux_future_is_ready (ses->f))
+    if (!is_root (ses) && !ses->parent_done)
         return;
 
-    if (xcg->rank == 0)
-        ses->data_out = json_incref (ses->data_in);
+    if (is_root (ses)) {
+        if (xcg->tuning) {
+            if (!xcg->ping_f && ping_start (xcg) < 0) {
+                shell_warn ("error sending pmix-exchange-ping");
+                xcg->hop_latency = 0;
+            }
+            /* Awaiting latency probe?
+             */
+            if (xcg->hop_latency < 0)
+                return;
+            if (autotune_append (xcg, ses) < 0) {
+                shell_warn ("error appending exchange fanout autotune");
+                ses->has_error = 1;
+                goto done;
+            }
+        }
+        /* A stripe result keeps its segments for reassembly.
+         */
+        if (ses->stripe != XHDR_NOSTRIPE) {
+            if (ses->data_in
+                && blobvec_encode (ses->data_in,
+                                   &ses->data_out,
+                                   &ses->data_out_size) < 0) {
+                shell_warn ("error encoding pmix-exchange stripe result");
+                ses->has_error = 1;
+                goto done;
+            }
+            if (ses->data_out_size == 0)
+                ses->data_out = NULL;
+        }
+        else if (ses->buf_size > 0) {
+            ses->data_out = ses->buf;
+            ses->data_out_size = ses->buf_size;
+        }
+        if (xcg->evb && evbcast_publish (xcg->evb,
+                                         ses->seq,
+                                         ses->stripe,
+                                         ses->data_out,
+                                         ses->data_out_size) < 0) {
+            shell_warn ("error publishing pmix-exchange result");
+            ses->has_error = 1;
+            goto done;
+        }
+    }
+
+    /* Requests are one-way if the result is broadcast by event.
+     */
+    if (xcg->evb)
+        goto done;
 
     /* Send exchange response(s), if needed.
+     * N.B. each response message gets its own copy of the result, since
+     * flux messages can't share a payload.  Only the result buffer that
+     * they are copied from is shared.
      */
     while ((msg = flux_msglist_pop (ses->requests))) {
-        if (flux_respond_pack (h, msg, "{s:O}", "data", ses->data_out) < 0) {
+        int rc;
+
+        if (rdelta (xcg))
+            rc = respond_delta (ses, msg);
+        else
+            rc = respond_data (ses, msg, ses->data_out, ses->data_out_size);
+        if (rc < 0) {
             shell_warn ("error responding to pmix-exchange request");
             flux_msg_decref (msg);
             ses->has_error = 1;
@@ -173,22 +1057,130 @@ static void session_process (struct session *ses)
         flux_msg_decref (msg);
     }
 done:
-    ses->exit_cb (xcg, ses->exit_cb_arg);
-    session_destroy (ses);
-    xcg->session = NULL;
+    session_finish (ses);
+}
+
+/* Take the result from a response sent by respond_delta().
+ */
+static int response_delta (struct session *ses,
+                           const flux_msg_t *msg,
+                           const void *buf,
+                           size_t size)
+{
+    uint32_t base;
+
+    if (size < sizeof (base))
+        goto eproto;
+    memcpy (&base, buf, sizeof (base));
+    if (ntohl (base) != XHDR_NOBASE) {
+        if (!ses->rpin || ses->rpin->seq != ntohl (base))
+            goto eproto;
+        ses->data_out = ses->rpin->data;
+        ses->data_out_size = ses->rpin->size;
+        return 0;
+    }
+    if (size > sizeof (base)) {
+        ses->msg = flux_msg_incref (msg);
+        ses->data_out = (uint8_t *)buf + sizeof (base);
+        ses->data_out_size = size - sizeof (base);
+    }
+    return 0;
+eproto:
+    errno = EPROTO;
+    return -1;
+}
+
+/* Append a chunk of a streamed response to the result buffer, and relay
+ * it to any children that requested a streaming response.
+ */
+static int relay_chunk (struct session *ses, const void *buf, size_t size)
+{
+    flux_t *h = flux_shell_get_flux (ses->xcg->shell);
+    const flux_msg_t *msg;
+
+    if (buf_append (ses, buf, size) < 0)
+        return -1;
+
+    msg = flux_msglist_first (ses->requests);
+    while (msg) {
+        if (flux_msg_is_streaming (msg)) {
+            if (flux_respond_raw (h, msg, buf, size) < 0)
+                return -1;
+        }
+        msg = flux_msglist_next (ses->requests);
+    }
+    ses->relayed = true;
+    return 0;
+}
+
+/* parent shell has responded to streaming pmix-exchange request.
+ * Relay each chunk as it arrives.  ENODATA terminates the stream.
+ */
+static void exchange_stream_continuation (struct session *ses,
+                                          flux_future_t *f)
+{
+    const void *buf;
+    size_t size;
+
+    if (flux_rpc_get_raw (f, &buf, &size) < 0) {
+        if (errno != ENODATA) {
+            shell_warn ("pmix-exchange request: %s",
+                        future_strerror (f, errno));
+            ses->has_error = 1;
+        }
+        else if (ses->buf_size > 0) {
+            ses->data_out = ses->buf;
+            ses->data_out_size = ses->buf_size;
+        }
+        ses->parent_done = true;
+        session_process (ses);
+        return;
+    }
+    if (relay_chunk (ses, buf, size) < 0) {
+        shell_warn ("error relaying pmix-exchange response: %s",
+                    strerror (errno));
+        ses->has_error = 1;
+        session_process (ses);
+        return;
+    }
+    flux_future_reset (f);
 }
 
 /* parent shell has responded to pmix-exchange request.
+ * Rather than copying the response payload, keep a reference on the
+ * response message and use its payload directly as data_out.
+ * An empty response (barrier) leaves data_out NULL.
  */
 static void exchange_response_completion (flux_future_t *f, void *arg)
 {
-    struct exchange *xcg = arg;
+    struct session *ses = arg;
+    struct exchange *xcg = ses->xcg;
+    const flux_msg_t *msg;
+    const void *buf;
+    size_t size;
 
-    if (flux_rpc_get_unpack (f, "{s:O}", "data", &xcg->session->data_out) < 0) {
+    if (xcg->chunk_size > 0) {
+        exchange_stream_continuation (ses, f);
+        return;
+    }
+    if (flux_rpc_get_raw (f, &buf, &size) < 0
+        || flux_future_get (f, (const void **)&msg) < 0) {
         shell_warn ("pmix-exchange request: %s", future_strerror (f, errno));
-        xcg->session->has_error = 1;
+        ses->has_error = 1;
+    }
+    else if (rdelta (xcg)) {
+        if (response_delta (ses, msg, buf, size) < 0) {
+            shell_warn ("pmix-exchange response: %s", strerror (errno));
+            ses->has_error = 1;
+        }
+    }
+    else if (size > 0) {
+        ses->msg = flux_msg_incref (msg);
+        ses->data_out = buf;
+        ses->data_out_size = size;
     }
-    session_process (xcg->session);
+    ses->parent_done = true;
+    session_process (ses);
 }
 
 /* child shell sent a pmix-exchange request
@@ -199,100 +1191,677 @@ static void exchange_request_cb (flux_t *h,
                                  void *arg)
 {
     struct exchange *xcg = arg;
-    json_t *data;
+    const void *buf;
+    size_t size;
+    struct xhdr hdr;
+    bool have_hdr = false;
+    struct session *ses = NULL;
+    const flux_msg_t *datamsg = msg; // message holding the data
     const char *errstr = NULL;
+    double t = 0;
 
-    if (flux_request_unpack (msg, NULL, "{s:o}", "data", &data) < 0)
+    if (xcg->tuning && xcg->rank == 0)
+        t = now (xcg);
+    if (flux_request_decode_raw (msg, NULL, &buf, &size) < 0)
+        goto error;
+    if (size < sizeof (hdr)) {
+        errstr = "exchange request is missing header";
+        errno = EPROTO;
         goto error;
-    if (!xcg->session) {
-        if (!(xcg->session = session_create (xcg)))
-            goto error;
     }
-    if (flux_msglist_count (xcg->session->requests) == xcg->child_count) {
+    memcpy (&hdr, buf, sizeof (hdr));
+    have_hdr = true;
+    if (!(ses = session_lookup (xcg, ntohl (hdr.seq), ntohl (hdr.stripe))))
+        goto error;
+    /* N.B. during autotune, a request may arrive from a child in the
+     * retuned tree, whose shape is not yet known here.
+     */
+    if (!xcg->tuning
+        && flux_msglist_count (ses->requests) == ses_child_count (ses)) {
         errstr = "exchange received too many child requests";
         errno = EINPROGRESS;
         goto error;
     }
-    if (json_array_extend (xcg->session->data_in, data) < 0) {
-        errstr = "exchange request failed to extend data_in array";
-        errno = ENOMEM;
-        goto error;
+    if (ntohl (hdr.base) != XHDR_NOBASE) {
+        errno = EPROTO;
+        if (!xcg->delta
+            || !(datamsg = delta_lookup (xcg->delta,
+                                         ntohl (hdr.rank),
+                                         ntohl (hdr.base)))
+            || flux_request_decode_raw (datamsg, NULL, &buf, &size) < 0) {
+            errstr = "exchange request refers to unknown data";
+            goto error;
+        }
+    }
+    else if (xcg->delta && size > sizeof (hdr)) {
+        if (delta_save (xcg->delta,
+                        ntohl (hdr.rank),
+                        ntohl (hdr.seq),
+                        msg) < 0) {
+            errstr = "exchange request failed to save data for delta";
+            goto error;
+        }
+    }
+    if (size > sizeof (hdr)) {
+        const void *data = (uint8_t *)buf + sizeof (hdr);
+        size_t datasize = size - sizeof (hdr);
+
+        if (is_root (ses) && ses->stripe == XHDR_NOSTRIPE) {
+            if (buf_extend (ses, datamsg, data, datasize) < 0) {
+                errstr = "exchange request failed to extend result";
+                goto error;
+            }
+        }
+        else if (data_in_extend (ses, data, datasize) < 0) {
+            errstr = "exchange request failed to extend data_in";
+            goto error;
+        }
     }
-    if (flux_msglist_append (xcg->session->requests, msg) < 0) {
+    if (flux_msglist_append (ses->requests, msg) < 0) {
         errstr = "exchange request failed to save pending request";
         goto error;
     }
-    session_process (xcg->session);
+    if (xcg->tuning && xcg->rank == 0) {
+        xcg->msg_time += now (xcg) - t;
+        xcg->msg_count++;
+    }
+    session_process (ses);
     return;
 error:
+    /* A one-way request can't get an error response, so fail the exchange
+     * on all shells with an error event.
+     */
+    if (xcg->evb) {
+        shell_warn ("pmix-exchange request: %s",
+                    errstr ? errstr : strerror (errno));
+        if (!have_hdr)
+            return;
+        publish_error (xcg, ntohl (hdr.seq), ntohl (hdr.stripe));
+        if (ses) {
+            ses->has_error = 1;
+            ses->error_sent = true;
+            session_process (ses);
+        }
+        return;
+    }
     if (flux_respond_error (h, msg, errno, errstr) < 0)
         shell_warn ("error responding to pmix-exchange request: %s",
                     flux_strerror (errno));
 }
 
+static void allgather_exit_cb (struct blobvec *result, void *arg)
+{
+    struct session *ses = arg;
+    void *data;
+    size_t size;
+
+    if (!result || blobvec_decode (result, &data, &size) < 0)
+        ses->has_error = 1;
+    else {
+        ses->buf = data;
+        ses->buf_size = ses->buf_length = size;
+        if (size > 0) {
+            ses->data_out = ses->buf;
+            ses->data_out_size = size;
+        }
+    }
+    session_finish (ses);
+}
+
+/* the root shell published the result of an exchange.
+ */
+static void exchange_event_cb (const flux_msg_t *msg,
+                               uint32_t seq,
+                               uint32_t stripe,
+                               const void *data,
+                               size_t size,
+                               void *arg)
+{
+    struct exchange *xcg = arg;
+    struct session *ses;
+
+    if (!(ses = session_find (xcg, seq, stripe)) || ses->parent_done) {
+        shell_warn ("ignoring pmix-exchange result event for seq=%u", seq);
+        return;
+    }
+    if (size > 0) {
+        ses->msg = flux_msg_incref (msg);
+        ses->data_out = data;
+        ses->data_out_size = size;
+    }
+    ses->parent_done = true;
+    session_process (ses);
+}
+
+/* a shell published an error for an exchange.
+ * The session is created if this shell hasn't entered the exchange yet,
+ * so that it fails when it does.
+ */
+static void exchange_error_event_cb (uint32_t seq,
+                                     uint32_t stripe,
+                                     uint32_t rank,
+                                     void *arg)
+{
+    struct exchange *xcg = arg;
+    struct session *ses;
+
+    if (!(ses = session_lookup (xcg, seq, stripe))) {
+        shell_warn ("error handling pmix-exchange error event: %s",
+                    strerror (errno));
+        return;
+    }
+    if (ses->parent_done)
+        return;
+    shell_warn ("pmix-exchange seq=%u failed on shell rank %u", seq, rank);
+    ses->has_error = 1;
+    ses->error_sent = true;
+    session_process (ses);
+}
+
+/* rank 0 is measuring the per-hop RPC latency.
+ */
+static void exchange_ping_cb (flux_t *h,
+                              flux_msg_handler_t *mh,
+                              const flux_msg_t *msg,
+                              void *arg)
+{
+    if (flux_respond_raw (h, msg, NULL, 0) < 0)
+        shell_warn ("error responding to pmix-exchange-ping request: %s",
+                    flux_strerror (errno));
+}
+
+/* Append this shell's contribution to data_in, compressed if it is large
+ * enough and compression pays off.
+ */
+static int append_contribution (struct session *ses,
+                                const void *data,
+                                size_t size)
+{
+    struct exchange *xcg = ses->xcg;
+    void *zdata;
+    size_t zsize;
+    int rc;
+
+    if (!ses->data_in && !(ses->data_in = blobvec_create ()))
+        return -1;
+    if (xcg->compress_min == 0 || size < xcg->compress_min)
+        goto raw;
+    if (xcg->compress_skip > 0) {
+        xcg->compress_skip--;
+        goto raw;
+    }
+    if (zcodec_compress (data, size, &zdata, &zsize) < 0) {
+        shell_warn ("error compressing pmix-exchange data: %s",
+                    strerror (errno));
+        goto raw;
+    }
+    if (zsize > size - size / 8) {
+        shell_trace ("compression of pmix-exchange data is poor (%zu -> %zu),"
+                     " skipping it for %d exchanges",
+                     size,
+                     zsize,
+                     COMPRESS_BACKOFF);
+        xcg->compress_skip = COMPRESS_BACKOFF;
+        free (zdata);
+        goto raw;
+    }
+    rc = blobvec_append (ses->data_in, xcg->rank | ZSEG_FLAG, zdata, zsize);
+    free (zdata);
+    return rc;
+raw:
+    return blobvec_append (ses->data_in, xcg->rank, data, size);
+}
+
+/* Keep the result of stripe 'ses' as segments, without copying.
+ */
+static struct blobvec *stripe_result (struct session *ses)
+{
+    struct blobvec *bv;
+
+    if (is_root (ses))
+        return blobvec_incref (ses->data_in);
+    if (ses->buf) {
+        if (!(bv = blobvec_wrap (ses->buf, ses->buf_size, free, ses->buf)))
+            return NULL;
+        ses->buf = NULL;
+        return bv;
+    }
+    if (!(bv = blobvec_wrap (ses->data_out,
+                             ses->data_out_size,
+                             msg_decref,
+                             (void *)ses->msg)))
+        return NULL;
+    flux_msg_incref (ses->msg);
+    return bv;
+}
+
+/* Concatenate the pieces of each contribution from the stripe results,
+ * in stripe order.
+ */
+static int stripes_reassemble (struct session *whole)
+{
+    struct exchange *xcg = whole->xcg;
+    size_t *offsets;
+    size_t offset = 0;
+    const void *seg;
+    uint32_t id;
+    size_t size;
+
+    if (!(offsets = calloc (xcg->size, sizeof (offsets[0]))))
+        return -1;
+    for (int i = 0; i < xcg->stripes; i++) {
+        seg = blobvec_first (whole->stripes[i], &id, &size);
+        while (seg) {
+            if (id >= xcg->size) {
+                free (offsets);
+                errno = EPROTO;
+                return -1;
+            }
+            offsets[id] += size;
+            seg = blobvec_next (whole->stripes[i], &id, &size);
+        }
+    }
+    for (int i = 0; i < xcg->size; i++) {
+        size = offsets[i];
+        offsets[i] = offset;
+        offset += size;
+    }
+    if (offset > 0) {
+        if (!(whole->buf = malloc (offset))) {
+            free (offsets);
+            return -1;
+        }
+        for (int i = 0; i < xcg->stripes; i++) {
+            seg = blobvec_first (whole->stripes[i], &id, &size);
+            while (seg) {
+                memcpy (whole->buf + offsets[id], seg, size);
+                offsets[id] += size;
+                seg = blobvec_next (whole->stripes[i], &id, &size);
+            }
+        }
+        whole->buf_size = whole->buf_length = offset;
+        whole->data_out = whole->buf;
+        whole->data_out_size = offset;
+    }
+    free (offsets);
+    return 0;
+}
+
+/* A stripe of a striped exchange is complete.  Keep its result, and once
+ * all stripes are complete, reassemble the result and notify the caller.
+ */
+static void stripe_exit_cb (struct exchange *xcg, void *arg)
+{
+    struct session *whole = arg;
+    struct session *ses = xcg->current;
+
+    if (ses->has_error)
+        whole->has_error = 1;
+    else if (ses->data_out
+             && !(whole->stripes[ses->stripe] = stripe_result (ses))) {
+        shell_warn ("error saving pmix-exchange stripe %u: %s",
+                    ses->stripe,
+                    strerror (errno));
+        whole->has_error = 1;
+    }
+    if (--whole->stripes_pending > 0)
+        return;
+    if (!whole->has_error && stripes_reassemble (whole) < 0) {
+        shell_warn ("error reassembling pmix-exchange stripes: %s",
+                    strerror (errno));
+        whole->has_error = 1;
+    }
+    xcg->current = whole;
+    whole->exit_cb (xcg, whole->exit_cb_arg);
+    xcg->current = ses;
+    session_destroy (whole);
+}
+
+/* Split this shell's contribution into one piece per stripe and enter
+ * each stripe's exchange.  Everything that may fail is done before any
+ * stripe session is linked or modified, so on failure the sessions that
+ * children may already have created are left as they were.
+ */
+static int enter_striped (struct exchange *xcg,
+                          uint32_t seq,
+                          const void *data,
+                          size_t size,
+                          exchange_exit_f exit_cb,
+                          void *exit_cb_arg)
+{
+    struct session *whole;
+    struct session **stripes = NULL;    // session of each stripe
+    struct blobvec **pieces = NULL;     // new data_in of each stripe
+    struct session *ses;
+
+    if ((ses = session_find (xcg, seq, 0)) && ses->local) {
+        errno = EEXIST;
+        return -1;
+    }
+    if (!(whole = session_create (xcg, seq, XHDR_NOSTRIPE))
+        || !(whole->stripes = calloc (xcg->stripes,
+                                      sizeof (whole->stripes[0])))
+        || !(stripes = calloc (xcg->stripes, sizeof (stripes[0])))
+        || !(pieces = calloc (xcg->stripes, sizeof (pieces[0]))))
+        goto error;
+    for (int i = 0; i < xcg->stripes; i++) {
+        size_t start = (uint64_t)i * size / xcg->stripes;
+        size_t end = (uint64_t)(i + 1) * size / xcg->stripes;
+        const void *buf;
+        size_t bufsize;
+
+        if (!(stripes[i] = session_find (xcg, seq, i))
+            && !(stripes[i] = session_create (xcg, seq, i)))
+            goto error;
+        if (!(pieces[i] = blobvec_create ())
+            || blobvec_append (pieces[i],
+                               xcg->rank,
+                               data ? (uint8_t *)data + start : NULL,
+                               end - start) < 0)
+            goto error;
+        if (stripes[i]->data_in
+            && (blobvec_encode (stripes[i]->data_in, &buf, &bufsize) < 0
+                || blobvec_extend (pieces[i], buf, bufsize) < 0))
+            goto error;
+    }
+    whole->exit_cb = exit_cb;
+    whole->exit_cb_arg = exit_cb_arg;
+    whole->local = 1;
+    whole->stripes_pending = xcg->stripes;
+    for (int i = 0; i < xcg->stripes; i++) {
+        ses = stripes[i];
+        if (!session_find (xcg, seq, i)) {
+            ses->next = xcg->sessions;
+            xcg->sessions = ses;
+        }
+        blobvec_destroy (ses->data_in);
+        ses->data_in = pieces[i];
+        pieces[i] = NULL;
+        ses->exit_cb = stripe_exit_cb;
+        ses->exit_cb_arg = whole;
+    }
+    free (pieces);
+    free (stripes);
+    for (int i = 0; i < xcg->stripes; i++) {
+        if ((ses = session_find (xcg, seq, i))) {
+            ses->local = 1;
+            session_process (ses);
+        }
+    }
+    return 0;
+error:
+    if (stripes) {
+        for (int i = 0; i < xcg->stripes; i++) {
+            if (stripes[i] && !session_find (xcg, seq, i))
+                session_destroy (stripes[i]);
+        }
+    }
+    if (pieces) {
+        for (int i = 0; i < xcg->stripes; i++)
+            blobvec_destroy (pieces[i]);
+    }
+    free (pieces);
+    free (stripes);
+    session_destroy (whole);
+    return -1;
+}
+
 /* this shell is ready to exchange.
  */
-int exchange_enter_base64_string (struct exchange *xcg,
-                                  json_t *data,
-                                  exchange_exit_f exit_cb,
-                                  void *exit_cb_arg)
+int exchange_enter (struct exchange *xcg,
+                    uint32_t seq,
+                    bool collect,
+                    const void *data,
+                    size_t size,
+                    exchange_exit_f exit_cb,
+                    void *exit_cb_arg)
 {
+    struct session *ses;
+    int algo;
+
     if (!xcg
         || !exit_cb
-        || (data && !json_is_string (data))) {
+        || (size > 0 && !data)
+        || (!collect && data)) {
         errno = EINVAL;
         return -1;
     }
-    if (!xcg->session) {
-        if (!(xcg->session = session_create (xcg)))
-            return -1;
-    }
-    if (xcg->session->local) {
-        errno = EINPROGRESS;
+    algo = collect ? xcg->algo : xcg->barrier_algo;
+    if (algo == ALGO_TREE && collect && xcg->stripes > 1)
+        return enter_striped (xcg, seq, data, size, exit_cb, exit_cb_arg);
+    if (!(ses = session_lookup (xcg, seq, XHDR_NOSTRIPE)))
+        return -1;
+    if (ses->local) {
+        errno = EEXIST;
         return -1;
     }
-    xcg->session->exit_cb = exit_cb;
-    xcg->session->exit_cb_arg = exit_cb_arg;
-    xcg->session->local = 1;
-    if (data) {
-        if (json_array_append (xcg->session->data_in, data) < 0) {
-            errno = ENOMEM;
+    ses->algo = algo;
+    if (algo != ALGO_TREE) {
+        ses->exit_cb = exit_cb;
+        ses->exit_cb_arg = exit_cb_arg;
+        ses->local = 1;
+        if (allgather_enter (xcg->ag,
+                             algo,
+                             seq,
+                             data,
+                             size,
+                             allgather_exit_cb,
+                             ses) < 0) {
+            ses->local = 0;
             return -1;
         }
+        return 0;
+    }
+    if (data) {
+        if (xcg->rank == 0) {
+            if (buf_append (ses, data, size) < 0)
+                return -1;
+        }
+        else if (append_contribution (ses, data, size) < 0)
+            return -1;
     }
-    session_process (xcg->session);
+    ses->exit_cb = exit_cb;
+    ses->exit_cb_arg = exit_cb_arg;
+    ses->local = 1;
+    if (xcg->tuning && !xcg->tune_started) {
+        xcg->tune_seq = seq;
+        xcg->tune_started = true;
+    }
+    session_process (ses);
     return 0;
 }
 
-/* Helper for exchange_create() - calculate the number of children of
- * 'rank' in a 'size' tree of degree 'k'.
+/* Parse algorithm option 'name'.  'allowed' is a mask of the algorithms
+ * besides "tree" that may be used for this kind of exchange.
  */
-static int child_count (int k, int rank, int size)
+static int parse_algo (const char *name, int allowed)
 {
-    int i;
-    int count = 0;
+    int algo;
 
-    for (i = 0; i < k; i++) {
-        if (kary_childof (k, size, rank, i) != KARY_NONE)
-            count++;
-    }
-    return count;
+    if (!name || !strcmp (name, "tree"))
+        return ALGO_TREE;
+    if ((algo = allgather_algo_lookup (name)) < 0
+        || !(allowed & (1 << algo)))
+        return -1;
+    return algo;
 }
 
 struct exchange *exchange_create (flux_shell_t *shell, int k)
 {
     struct exchange *xcg;
+    const char *service;
+    int chunk_size = 0;
+    const char *algo = NULL;
+    const char *barrier_algo = NULL;
+    json_t *fanout = NULL;
+    const char *broadcast = NULL;
+    int compress = 0;
+    int delta = 0;
+    int stripes = 1;
+    int balance = 0;
+    bool topology = false;
 
     if (!(xcg = calloc (1, sizeof (*xcg))))
         return NULL;
     xcg->shell = shell;
     if (flux_shell_info_unpack (shell,
-                                "{s:i s:i}",
+                                "{s:i s:i s:s}",
                                 "size", &xcg->size,
-                                "rank", &xcg->rank) < 0)
+                                "rank", &xcg->rank,
+                                "service", &service) < 0)
+        goto error;
+    if (asprintf (&xcg->topic, "%s.pmix-exchange", service) < 0
+        || asprintf (&xcg->ping_topic, "%s.pmix-exchange-ping", service) < 0
+        || !(xcg->brokermap = brokermap_create (shell)))
+        goto error;
+    if (flux_shell_getopt_unpack (shell,
+                                  "pmix",
+                                  "{s?{s?i s?s s?s s?o s?s s?i s?i s?i s?i}}",
+                                  "exchange",
+                                    "chunk-size", &chunk_size,
+                                    "algorithm", &algo,
+                                    "barrier", &barrier_algo,
+                                    "fanout", &fanout,
+                                    "broadcast", &broadcast,
+                                    "compress", &compress,
+                                    "delta", &delta,
+                                    "stripes", &stripes,
+                                    "balance", &balance) < 0) {
+        shell_log_error ("error parsing pmix.exchange shell options");
+        goto error;
+    }
+    if (chunk_size < 0) {
+        shell_log_error ("pmix.exchange.chunk-size must be an integer >= 0");
+        goto error;
+    }
+    if (compress < 0) {
+        shell_log_error ("pmix.exchange.compress must be an integer >= 0");
+        goto error;
+    }
+    if (stripes < 1) {
+        shell_log_error ("pmix.exchange.stripes must be an integer >= 1");
+        goto error;
+    }
+    if (stripes > xcg->size)
+        stripes = xcg->size;
+    xcg->stripes = stripes;
+    if (stripes > 1) {
+        if (compress > 0 || delta) {
+            if (xcg->rank == 0)
+                shell_warn ("pmix.exchange compress and delta"
+                            " are ignored with stripes");
+            compress = delta = 0;
+        }
+        if (xcg->rank == 0)
+            shell_debug ("using exchange stripes=%d", stripes);
+    }
+    if (balance) {
+        if (stripes > 1) {
+            if (xcg->rank == 0)
+                shell_warn ("pmix.exchange.balance is ignored with stripes");
+        }
+        else {
+            xcg->balance = true;
+            if (xcg->rank == 0)
+                shell_debug ("using exchange balance");
+        }
+    }
+    xcg->compress_min = compress;
+    if (xcg->rank == 0 && compress > 0)
+        shell_debug ("using exchange compress=%d", compress);
+    if (delta) {
+        if (!(xcg->delta = delta_create (xcg->size)))
+            goto error;
+        if (xcg->rank == 0)
+            shell_debug ("using exchange delta");
+    }
+    if ((xcg->algo = parse_algo (algo,
+                                 (1 << ALLGATHER_RING)
+                                 | (1 << ALLGATHER_BRUCK))) < 0) {
+        shell_log_error ("pmix.exchange.algorithm must be"
+                         " tree, ring, or bruck");
+        goto error;
+    }
+    if ((xcg->barrier_algo = parse_algo (barrier_algo,
+                                         (1 << ALLGATHER_DISSEMINATION))) < 0) {
+        shell_log_error ("pmix.exchange.barrier must be tree or dissemination");
         goto error;
+    }
+    if (xcg->rank == 0) {
+        shell_debug ("using exchange algorithm=%s barrier=%s",
+                     algo ? algo : "tree",
+                     barrier_algo ? barrier_algo : "tree");
+    }
+    if (xcg->algo != ALGO_TREE || xcg->barrier_algo != ALGO_TREE) {
+        if (!(xcg->ag = allgather_create (shell, xcg->brokermap)))
+            goto error;
+    }
+    if (broadcast && !strcmp (broadcast, "event")) {
+        if (chunk_size > 0) {
+            if (xcg->rank == 0)
+                shell_warn ("pmix.exchange.chunk-size is ignored"
+                            " with broadcast=event");
+            chunk_size = 0;
+        }
+        if (!(xcg->evb = evbcast_create (shell,
+                                         exchange_event_cb,
+                                         exchange_error_event_cb,
+                                         xcg)))
+            goto error;
+        if (xcg->rank == 0)
+            shell_debug ("using exchange broadcast=event");
+    }
+    else if (broadcast && strcmp (broadcast, "tree") != 0) {
+        shell_log_error ("pmix.exchange.broadcast must be tree or event");
+        goto error;
+    }
+    xcg->chunk_size = chunk_size;
+    if (xcg->rank == 0 && chunk_size > 0)
+        shell_debug ("using exchange chunk-size=%d", chunk_size);
+    if (fanout) {
+        if (json_is_string (fanout)
+            && !strcmp (json_string_value (fanout), "auto")) {
+            k = tree_autotune_initial_fanout (xcg->size);
+            if (xcg->stripes > 1) {
+                if (xcg->rank == 0)
+                    shell_warn ("pmix.exchange.fanout=auto is not tuned"
+                                " with stripes");
+            }
+            else {
+                xcg->tuning = xcg->size > 2 ? true : false;
+                xcg->hop_latency = -1;
+            }
+        }
+        else if (json_is_string (fanout)
+                 && !strcmp (json_string_value (fanout), "topology"))
+            topology = true;
+        else if (json_is_integer (fanout) && json_integer_value (fanout) > 0)
+            k = json_integer_value (fanout);
+        else {
+            shell_log_error ("pmix.exchange.fanout must be an integer > 0,"
+                             " \"auto\", or \"topology\"");
+            goto error;
+        }
+    }
+    if (topology) {
+        if (xcg->balance) {
+            if (xcg->rank == 0)
+                shell_warn ("pmix.exchange.balance is ignored"
+                            " with fanout=topology");
+            xcg->balance = false;
+        }
+        if (set_topology (xcg) < 0) {
+            shell_log_error ("error deriving exchange tree"
+                             " from overlay topology: %s",
+                             strerror (errno));
+            goto error;
+        }
+        if (xcg->rank == 0)
+            shell_debug ("using exchange tree from overlay topology");
+        goto register_services;
+    }
     if (k <= 0)
-        k = DEFAULT_TREE_K;
+        k = TREE_DEFAULT_K < xcg->size ? TREE_DEFAULT_K : xcg->size;
     else if (k > xcg->size) {
         k = xcg->size;
         if (xcg->rank == 0)
@@ -300,15 +1869,20 @@ struct exchange *exchange_create (flux_shell_t *shell, int k)
     }
     else {
         if (xcg->rank == 0)
-            shell_debug ("using k=%d", k);
+            shell_debug ("using k=%d%s", k, xcg->tuning ? " (autotune)" : "");
     }
-    xcg->parent_rank = kary_parentof (k, xcg->rank);
-    xcg->child_count = child_count (k, xcg->rank, xcg->size);
+    if (set_fanout (xcg, k) < 0)
+        goto error;
 
+register_services:
     if (flux_shell_service_register (shell,
                                      "pmix-exchange",
                                      exchange_request_cb,
-                                     xcg) < 0)
+                                     xcg) < 0
+        || flux_shell_service_register (shell,
+                                        "pmix-exchange-ping",
+                                        exchange_ping_cb,
+                                        xcg) < 0)
         goto error;
     return xcg;
 error:
@@ -320,7 +1894,19 @@ void exchange_destroy (struct exchange *xcg)
 {
     if (xcg) {
         int saved_errno = errno;
-        session_destroy (xcg->session);
+        struct session *ses;
+        while ((ses = xcg->sessions)) {
+            xcg->sessions = ses->next;
+            session_destroy (ses);
+        }
+        delta_destroy (xcg->delta);
+        xresult_decref (xcg->rcache);
+        allgather_destroy (xcg->ag);
+        brokermap_destroy (xcg->brokermap);
+        flux_future_destroy (xcg->ping_f);
+        evbcast_destroy (xcg->evb);
+        free (xcg->ping_topic);
+        free (xcg->topic);
         free (xcg);
         errno = saved_errno;
     }
@@ -328,45 +1914,31 @@ void exchange_destroy (struct exchange *xcg)
 
 bool exchange_has_error (struct exchange *xcg)
 {
-    return xcg->session->has_error ? true : false;
+    return xcg->current->has_error ? true : false;
 }
 
-/* Convert internal array of base64 json strings to one continguous
- * data blob that the caller must free.
+/* Lend the concatenated result, in the message or buffer that holds it.
+ * An empty result is NULL.
  */
-int exchange_get_data (struct exchange *xcg, void **datap, size_t *sizep)
+int exchange_get_data (struct exchange *xcg,
+                       const void **datap,
+                       size_t *sizep,
+                       void **holdp)
 {
-    size_t bufsize = 0;
-    size_t index;
-    json_t *value;
-    uint8_t *data = NULL;
-    size_t size = 0;
+    struct session *ses = xcg->current;
+    struct xresult *xr = NULL;
 
-    // compute buffer size and allocate
-    json_array_foreach (xcg->session->data_out, index, value) {
-        ssize_t chunksize = codec_data_decode_bufsize (value);
-        if (chunksize < 0)
-            return -1;
-        bufsize += chunksize;
-    }
-    if (!(data = malloc (bufsize)))
+    if (ses->data_out && !(xr = session_result (ses)))
         return -1;
-
-    // decode array to buffer
-    json_array_foreach (xcg->session->data_out, index, value) {
-        ssize_t chunksize = codec_data_decode_tobuf (value,
-                                                     data + size,
-                                                     bufsize - size);
-        if (chunksize < 0)
-            goto error;
-        size += chunksize;
-    }
-    *datap = data;
-    *sizep = size;
+    *datap = ses->data_out;
+    *sizep = ses->data_out ? ses->data_out_size : 0;
+    *holdp = xresult_incref (xr);
     return 0;
-error:
-    free (data);
-    return -1;
+}
+
+void exchange_release (void *hold)
+{
+    xresult_decref (hold);
 }
 
 /* vi: ts=4 sw=4 expandtab
@@ -11,8 +11,9 @@
 #ifndef _PX_EXCHANGE_H
 #define _PX_EXCHANGE_H
 
-/* Create handle for performing multiple sequential exchanges.
- * 'k' is the tree fanout (k=0 selects internal default).
+/* Create handle for performing multiple, possibly concurrent exchanges.
+ * 'k' is the tree fanout (0=default), which the pmix.exchange.fanout shell
+ * option overrides.
  */
 struct exchange *exchange_create (flux_shell_t *shell, int k);
 void exchange_destroy (struct exchange *xcg);
@@ -20,13 +21,24 @@ void exchange_destroy (struct exchange *xcg);
 typedef void (*exchange_exit_f)(struct exchange *xcg, void *arg);
 
 /* Perform one exchange across all shell ranks.
- * 'data' is the input from this shell, in the form of a base64 json string.
+ * 'seq' identifies the exchange and must be the same on all shells.
+ * Exchanges with different 'seq' values may be in progress concurrently.
+ * If 'seq' is counted locally, every shell must enter the same exchanges
+ * in the same order.
+ * 'collect' selects between a data exchange and a barrier, which may use
+ * different algorithms, so it too must be the same on all shells.
+ * 'data' is the raw input from this shell (NULL if there is none, which
+ * is the only choice for a barrier).  A barrier carries no data, so no
+ * data buffers are allocated along the way.
  * Once the the result of the exchange is available, 'exit_cb' is invoked.
  */
-int exchange_enter_base64_string (struct exchange *xcg,
-                                  json_t *data,
-                                  exchange_exit_f exit_cb,
-                                  void *exit_cb_arg);
+int exchange_enter (struct exchange *xcg,
+                    uint32_t seq,
+                    bool collect,
+                    const void *data,
+                    size_t size,
+                    exchange_exit_f exit_cb,
+                    void *exit_cb_arg);
 
 /* This may be called from the exchange_exit_f callback
  * to determine whether or not the exchange was successful.
@@ -34,12 +46,19 @@ int exchange_enter_base64_string (struct exchange *xcg,
 bool exchange_has_error (struct exchange *xcg);
 
 /* Accessor to be called only from exchange_exit_f callback.
- * The caller must free the 'data' result, if successful.
- * 'data' is built by decoding the base64-encoded blobs collected from
- * each shell and concatenating them in random order.
+ * 'data' is built by concatenating the blobs collected from each shell
+ * in random order.
  * This is consistent with the semantics of the fence_nb server callback.
+ * It is not copied:  it remains valid until 'hold' is passed to
+ * exchange_release(), which must be called from the shell thread.
+ * If the result is empty, 'data' and 'hold' are set to NULL.
  */
-int exchange_get_data (struct exchange *xcg, void **data, size_t *size);
+int exchange_get_data (struct exchange *xcg,
+                       const void **data,
+                       size_t *size,
+                       void **hold);
+
+void exchange_release (void *hold);
 
 #endif // _PX_EXCHANGE_H
 
@@ -9,12 +9,22 @@
 \************************************************************/
 
 /* fence.c - handle fence_nb callback from openpmix server
+ *
+ * When pmix.exchange.directory=N is set, a collecting fence first exchanges
+ * a directory with one fixed size entry per shell:  the size of its
+ * contribution.  Every shell sees the same directory, so they all agree on
+ * the aggregate size.  If it is within N bytes, the data is exchanged as
+ * usual in a second round.  Otherwise the fence completes without data,
+ * and pmix pulls what each process actually reads with direct modex
+ * requests to the shell that holds it.
  */
 
 #if HAVE_CONFIG_H
 #include "config.h"
 #endif
 #include <jansson.h>
+#include <pthread.h>
+#include <arpa/inet.h>
 #include <flux/core.h>
 #include <flux/shell.h>
 #include <pmix.h>
@@ -29,9 +39,21 @@
 struct fence {
     flux_shell_t *shell;
     struct interthread *it;
+    int upcall_type;                // interthread message type
+    int release_type;               // interthread message type
+    pthread_t thread;               // shell thread
     struct exchange *exchange;
     int trace_flag;
     int exchange_seq;
+    size_t directory;       // aggregate size threshold (0 = disabled)
+    fence_complete_f complete_cb;
+    void *complete_arg;
+};
+
+/* Directory entry in network byte order.
+ */
+struct dir_entry {
+    uint64_t size;
 };
 
 struct fence_call {
@@ -43,6 +65,9 @@ struct fence_call {
     void *cbdata;
     bool collect;
     int exchange_seq;
+    struct fence *fx;
+    void *data;             // local contribution (collecting fences only)
+    size_t ndata;
 };
 
 /* This is for the benefit of server callbacks that don't have
@@ -55,48 +80,207 @@ static void fence_call_destroy (struct fence_call *fxcall)
     if (fxcall) {
         int saved_errno = errno;
         free (fxcall->procs);
-        codec_info_array_destroy (fxcall->info, fxcall->ninfo);
+        free (fxcall->data);
+        codec_info_array_free (fxcall->info, fxcall->ninfo);
         free (fxcall);
         errno = saved_errno;
     }
 }
 
-static struct fence_call *fence_call_create (struct fence *fx)
+/* Copy the fence_nb arguments into a call record for the shell thread.
+ * N.B. this runs in the pmix server thread.
+ */
+static struct fence_call *fence_call_create (const pmix_proc_t procs[],
+                                             size_t nprocs,
+                                             const pmix_info_t info[],
+                                             size_t ninfo,
+                                             const char *data,
+                                             size_t ndata,
+                                             pmix_modex_cbfunc_t cbfunc,
+                                             void *cbdata)
 {
     struct fence_call *fxcall;
 
     if (!(fxcall = calloc (1, sizeof (*fxcall))))
         return NULL;
-    fxcall->exchange_seq = fx->exchange_seq++;
+    if (nprocs > 0) {
+        if (!(fxcall->procs = malloc (nprocs * sizeof (procs[0]))))
+            goto error;
+        memcpy (fxcall->procs, procs, nprocs * sizeof (procs[0]));
+        fxcall->nprocs = nprocs;
+    }
+    if (ninfo > 0) {
+        if (!(fxcall->info = codec_info_array_dup (info, ninfo)))
+            goto error;
+        fxcall->ninfo = ninfo;
+    }
+    if (ndata > 0) {
+        if (!(fxcall->data = malloc (ndata)))
+            goto error;
+        memcpy (fxcall->data, data, ndata);
+        fxcall->ndata = ndata;
+    }
+    fxcall->cbfunc = cbfunc;
+    fxcall->cbdata = cbdata;
     return fxcall;
+error:
+    fence_call_destroy (fxcall);
+    return NULL;
+}
+
+/* pmix is done with the exchanged data.  The exchange owns it, so
+ * release it in the shell thread.
+ * N.B. this normally runs in the pmix server thread.
+ */
+static void fence_release (void *hold)
+{
+    struct fence *fx = global_fence_ctx;
+
+    if (fx && pthread_equal (pthread_self (), fx->thread)) {
+        exchange_release (hold);
+        return;
+    }
+    if (!fx || interthread_send (fx->it, fx->release_type, hold) < 0)
+        fprintf (stderr, "error sending fence_release interthread message\n");
+}
+
+static void fence_release_cb (void *rec, void *arg)
+{
+    exchange_release (rec);
+}
+
+static void fence_complete (struct fence *fx)
+{
+    if (fx->complete_cb)
+        fx->complete_cb (fx->complete_arg);
 }
 
 static void exchange_exit_cb (struct exchange *xcg, void *arg)
 {
     struct fence_call *fxcall = arg;
-    void *data = NULL;
+    const void *data = NULL;
     size_t ndata = 0;
+    void *hold = NULL;
     int status = PMIX_ERROR;
 
     if (exchange_has_error (xcg)) {
         shell_warn ("pmix exchange failed");
         goto done;
     }
-    if (exchange_get_data (xcg, &data, &ndata) < 0) {
-        shell_warn ("error accessing pmix exchanged data");
-        goto done;
+    if (fxcall->collect) {
+        if (exchange_get_data (xcg, &data, &ndata, &hold) < 0) {
+            shell_warn ("error accessing pmix exchanged data");
+            goto done;
+        }
     }
     status = PMIX_SUCCESS;
+    fence_complete (fxcall->fx);
 done:
-    // N.B. pmix calls 'free' on data when fence is complete
+    // N.B. pmix calls fence_release() when it is done with data
     shell_trace ("completed pmix exchange %d: size %zu %s",
                  fxcall->exchange_seq,
                  ndata,
                  PMIx_Error_string (status));
-    fxcall->cbfunc (status, data, ndata, fxcall->cbdata, free, data);
+    fxcall->cbfunc (status,
+                    data,
+                    ndata,
+                    fxcall->cbdata,
+                    hold ? fence_release : NULL,
+                    hold);
+    fence_call_destroy (fxcall);
+}
+
+static uint64_t htonll (uint64_t val)
+{
+    return ((uint64_t)htonl (val & 0xffffffff) << 32) | htonl (val >> 32);
+}
+
+/* Sum the contribution sizes in the exchanged directory.
+ */
+static int directory_total (const void *data, size_t ndata, uint64_t *total)
+{
+    const struct dir_entry *dir = data;
+    size_t count = ndata / sizeof (*dir);
+    uint64_t sum = 0;
+
+    if (ndata % sizeof (*dir) != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    for (int i = 0; i < count; i++)
+        sum += htonll (dir[i].size); // N.B. htonll() is its own inverse
+    *total = sum;
+    return 0;
+}
+
+static void directory_exit_cb (struct exchange *xcg, void *arg)
+{
+    struct fence_call *fxcall = arg;
+    const void *data = NULL;
+    size_t ndata = 0;
+    void *hold = NULL;
+    uint64_t total;
+    int status = PMIX_ERROR;
+
+    if (exchange_has_error (xcg)) {
+        shell_warn ("pmix directory exchange failed");
+        goto error;
+    }
+    if (exchange_get_data (xcg, &data, &ndata, &hold) < 0
+        || directory_total (data, ndata, &total) < 0) {
+        shell_warn ("error accessing pmix exchanged directory");
+        goto error;
+    }
+    exchange_release (hold);
+    hold = NULL;
+    if (total > fxcall->fx->directory) {
+        shell_trace ("completed pmix exchange %d: %ju bytes in directory"
+                     " exceed threshold, deferring to direct modex",
+                     fxcall->exchange_seq,
+                     (uintmax_t)total);
+        status = PMIX_SUCCESS;
+        fence_complete (fxcall->fx);
+        goto error;
+    }
+    if (exchange_enter (xcg,
+                        fxcall->exchange_seq + 1,
+                        true,
+                        fxcall->data,
+                        fxcall->ndata,
+                        exchange_exit_cb,
+                        fxcall) < 0) {
+        shell_warn ("error initiating pmix exchange");
+        fxcall->cbfunc (PMIX_ERROR, NULL, 0, fxcall->cbdata, NULL, NULL);
+        fence_call_destroy (fxcall);
+        return;
+    }
+    free (fxcall->data);
+    fxcall->data = NULL;
+    return;
+error:
+    exchange_release (hold);
+    fxcall->cbfunc (status, NULL, 0, fxcall->cbdata, NULL, NULL);
     fence_call_destroy (fxcall);
 }
 
+/* Start the directory round.  The contribution is held in fxcall
+ * until the aggregate size is known.
+ */
+static int directory_enter (struct fence *fx, struct fence_call *fxcall)
+{
+    struct dir_entry ent = {
+        .size = htonll (fxcall->ndata),
+    };
+
+    return exchange_enter (fx->exchange,
+                           fxcall->exchange_seq,
+                           true,
+                           &ent,
+                           sizeof (ent),
+                           directory_exit_cb,
+                           fxcall);
+}
+
 /* Parse info[] attributes from the fence callback.
  * Return PMIX_SUCCESS or an error status.
  */
@@ -122,62 +306,81 @@ static int parse_fence_attr (struct fence_call *fxcall, pmix_info_t *info)
     return 0;
 }
 
-static void fence_shell_cb (const flux_msg_t *msg, void *arg)
+static void fence_shell_cb (void *rec, void *arg)
 {
     struct fence *fx = arg;
-    json_t *xprocs;
-    json_t *xinfo;
-    json_t *xdata;
-    json_t *xcbfunc;
-    json_t *xcbdata;
-    struct fence_call *fxcall;
+    struct fence_call *fxcall = rec;
     int rc;
 
-    if (!(fxcall = fence_call_create (fx))
-        || flux_msg_unpack (msg,
-                            "{s:o s:o s:o s:o s:o}",
-                            "procs", &xprocs,
-                            "info", &xinfo,
-                            "data", &xdata, // not further decoded here
-                            "cbfunc", &xcbfunc,
-                            "cbdata", &xcbdata) < 0
-        || codec_proc_array_decode (xprocs, &fxcall->procs, &fxcall->nprocs) < 0
-        || codec_info_array_decode (xinfo, &fxcall->info, &fxcall->ninfo) < 0
-        || codec_pointer_decode (xcbfunc, (void **)&fxcall->cbfunc) < 0
-        || codec_pointer_decode (xcbdata, &fxcall->cbdata) < 0
-        || fxcall->cbfunc == NULL) {
-        shell_warn ("error unpacking interthread fence_upcall message");
-        fence_call_destroy (fxcall);
-        return;
-    }
-    if (fxcall->nprocs > 1 || fxcall->procs[0].rank != PMIX_RANK_WILDCARD) {
+    fxcall->fx = fx;
+    if (fxcall->nprocs != 1 || fxcall->procs[0].rank != PMIX_RANK_WILDCARD) {
         shell_warn ("fence over proc subset is not supported by flux");
         rc = PMIX_ERR_NOT_SUPPORTED;
         goto error;
     }
+    /* Exchanges are matched across shells by sequence number, so every
+     * shell must number the same fences in the same order.  Since fences
+     * are always over all procs, every shell gets every fence, in program
+     * order.  If proc subsets were supported, fences would have to be
+     * numbered per proc set, e.g. a hash of the set plus a count.
+     * The directory round and the data round each need a sequence number.
+     * The data round uses exchange_seq + 1.
+     */
+    fxcall->exchange_seq = fx->exchange_seq++;
+    if (fx->directory > 0)
+        fx->exchange_seq++;
     for (int i = 0; i < fxcall->ninfo; i++) {
         if ((rc = parse_fence_attr (fxcall, &fxcall->info[i])) != PMIX_SUCCESS)
             goto error;
     }
     if (fx->trace_flag) {
-        shell_trace ("starting pmix exchange %d: size %zi",
+        shell_trace ("starting pmix exchange %d: size %zu",
                      fxcall->exchange_seq,
-                     fxcall->collect ? codec_data_length (xdata) : 0);
+                     fxcall->ndata);
+    }
+    if (fx->directory > 0 && fxcall->collect) {
+        if (directory_enter (fx, fxcall) < 0) {
+            shell_warn ("error initiating pmix directory exchange");
+            rc = PMIX_ERROR;
+            goto error;
+        }
+        return;
     }
-    if (exchange_enter_base64_string (fx->exchange,
-                                      fxcall->collect ? xdata : NULL,
-                                      exchange_exit_cb,
-                                      fxcall) < 0) {
+    if (exchange_enter (fx->exchange,
+                        fxcall->exchange_seq,
+                        fxcall->collect,
+                        fxcall->data,
+                        fxcall->ndata,
+                        exchange_exit_cb,
+                        fxcall) < 0) {
         shell_warn ("error initiating pmix exchange");
         rc = PMIX_ERROR;
         goto error;
     }
+    free (fxcall->data);
+    fxcall->data = NULL;
     return;
 error:
     fxcall->cbfunc (rc, NULL, 0, fxcall->cbdata, NULL, NULL);
     fence_call_destroy (fxcall);
 }
 
+/* Return true if the fence info[] array sets pmix.collect.
+ */
+static bool fence_collects (const pmix_info_t info[], size_t ninfo)
+{
+    for (int i = 0; i < ninfo; i++) {
+        if (!strcmp (info[i].key, "pmix.collect")
+            && info[i].value.type == PMIX_BOOL
+            && info[i].value.data.flag == true)
+            return true;
+    }
+    return false;
+}
+
+/* N.B. The data is only copied for fences that collect it.
+ * Otherwise this is just a barrier.
+ */
 int fence_server_cb (const pmix_proc_t procs[],
                      size_t nprocs,
                      const pmix_info_t info[],
@@ -188,35 +391,32 @@ int fence_server_cb (const pmix_proc_t procs[],
                      void *cbdata)
 {
     struct fence *fx = global_fence_ctx;
-    json_t *xprocs = NULL;
-    json_t *xinfo = NULL;
-    json_t *xdata = NULL;
-    json_t *xcbfunc = NULL;
-    json_t *xcbdata = NULL;
-    int rc = PMIX_SUCCESS;
-
-    if (!(xprocs = codec_proc_array_encode (procs, nprocs))
-        || !(xinfo = codec_info_array_encode (info, ninfo))
-        || !(xdata = codec_data_encode (data, ndata))
-        || !(xcbfunc = codec_pointer_encode (cbfunc))
-        || !(xcbdata = codec_pointer_encode (cbdata))
-        || interthread_send_pack (fx->it,
-                                  "fence_upcall",
-                                  "{s:O s:O s:O s:O s:O}",
-                                  "procs", xprocs,
-                                  "info", xinfo,
-                                  "data", xdata,
-                                  "cbfunc", xcbfunc,
-                                  "cbdata", xcbdata) < 0) {
+    struct fence_call *fxcall;
+
+    if (!cbfunc)
+        return PMIX_ERR_BAD_PARAM;
+    if (!fence_collects (info, ninfo))
+        ndata = 0;
+    if (!(fxcall = fence_call_create (procs,
+                                      nprocs,
+                                      info,
+                                      ninfo,
+                                      data,
+                                      ndata,
+                                      cbfunc,
+                                      cbdata))
+        || interthread_send (fx->it, fx->upcall_type, fxcall) < 0) {
         fprintf (stderr, "error sending fence_upcall interthread message\n");
-        rc = PMIX_ERROR;
+        fence_call_destroy (fxcall);
+        return PMIX_ERROR;
     }
-    json_decref (xprocs);
-    json_decref (xinfo);
-    json_decref (xdata);
-    json_decref (xcbfunc);
-    json_decref (xcbdata);
-    return rc;
+    return PMIX_SUCCESS;
+}
+
+void fence_set_complete_cb (struct fence *fx, fence_complete_f cb, void *arg)
+{
+    fx->complete_cb = cb;
+    fx->complete_arg = arg;
 }
 
 void fence_destroy (struct fence *fx)
@@ -233,13 +433,38 @@ void fence_destroy (struct fence *fx)
 struct fence *fence_create (flux_shell_t *shell, struct interthread *it)
 {
     struct fence *fx;
+    json_int_t directory = 0;
 
     if (!(fx = calloc (1, sizeof (*fx))))
         return NULL;
     fx->shell = shell;
     fx->it = it;
+    fx->thread = pthread_self ();
     fx->trace_flag = 1; // stuck on for now
-    if (interthread_register (it, "fence_upcall", fence_shell_cb, fx) < 0)
+    if (flux_shell_getopt_unpack (shell,
+                                  "pmix",
+                                  "{s?{s?I}}",
+                                  "exchange",
+                                    "directory", &directory) < 0) {
+        shell_warn ("error parsing pmix.exchange.directory option");
+        goto error;
+    }
+    if (directory < 0) {
+        shell_warn ("invalid pmix.exchange.directory value");
+        errno = EINVAL;
+        goto error;
+    }
+    fx->directory = directory;
+    if ((fx->upcall_type = interthread_register (it,
+                                                 "fence_upcall",
+                                                 fence_shell_cb,
+                                                 fx,
+                                                 0)) < 0
+        || (fx->release_type = interthread_register (it,
+                                                     "fence_release",
+                                                     fence_release_cb,
+                                                     fx,
+                                                     0)) < 0)
         goto error;
     if (!(fx->exchange = exchange_create (shell, 0)))
         goto error;
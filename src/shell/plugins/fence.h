@@ -21,6 +21,11 @@
 struct fence *fence_create (flux_shell_t *shell, struct interthread *it);
 void fence_destroy (struct fence *dx);
 
+/* Call 'cb' in the shell thread each time a fence completes successfully.
+ */
+typedef void (*fence_complete_f)(void *arg);
+void fence_set_complete_cb (struct fence *fx, fence_complete_f cb, void *arg);
+
 /* Server fence_nb callback registered with PMIx_server_init().
  */
 int fence_server_cb (const pmix_proc_t proc[],
@@ -9,12 +9,49 @@
 \************************************************************/
 
 /* interthread.c - message channel from pmix server thread -> shell thread
+ *
+ * Each message carries only a pointer to a call record allocated by the
+ * sender.  The record is handed to the registered handler as is.
+ * Handlers are identified by the integer message type returned at
+ * registration, which indexes the handler table directly.
+ *
+ * Messages are queued in bounded single-producer, single-consumer rings
+ * of (handler, record) slots, so sending normally allocates nothing and
+ * takes no lock.  The producer is the pmix server thread, and the consumer
+ * is the shell reactor.  The producer publishes a slot by advancing 'tail'
+ * with release semantics, then rings an eventfd doorbell that the reactor
+ * watches.  The doorbell is only a wakeup hint:  once a slot is published,
+ * the message will be handled.
+ *
+ * The producer must never wait for the shell thread, which makes blocking
+ * pmix calls that need the pmix server thread.  So if the ring is full,
+ * messages go on a mutex protected overflow list instead, and keep going
+ * there until the shell thread has emptied it, to preserve their order.
+ *
+ * There is one ring per priority lane.  Messages of types registered
+ * with INTERTHREAD_URGENT (abort, notify) go in the urgent lane, which
+ * is always drained before the normal lane, so that a failing job is
+ * not held up behind a backlog of fence and dmodex upcalls.  Order is
+ * preserved within a lane only.
+ *
+ * Each reactor wakeup clears the doorbell and handles up to
+ * pmix.interthread.batch messages.  If more remain, it rings the
+ * doorbell itself so the reactor comes back after servicing other
+ * watchers.  The deepest queue observed is logged at debug level
+ * on exit.
  */
 
 #if HAVE_CONFIG_H
 #include "config.h"
 #endif
-#include <jansson.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <flux/core.h>
 
 #include "src/common/libutil/strlcpy.h"
@@ -22,65 +59,197 @@
 #include "interthread.h"
 
 #define MAX_HANDLERS 32
+#define RING_SIZE 1024 // power of 2
+#define DEFAULT_BATCH 32
+
+enum {
+    LANE_URGENT = 0,                // drained first
+    LANE_NORMAL = 1,
+    LANE_COUNT = 2,
+};
 
 struct handler {
     char topic[32];
     interthread_msg_handler_f cb;
     void *arg;
+    int lane;
+};
+
+struct slot {
+    struct handler *handler;
+    void *rec;
+};
+
+struct overflow {
+    struct slot slot;
+    struct overflow *next;
+};
+
+struct lane {
+    struct slot ring[RING_SIZE];
+    _Atomic size_t head;            // next slot to receive (consumer)
+    _Atomic size_t tail;            // next slot to send (producer)
+    size_t max_depth;               // deepest queue observed
+
+    pthread_mutex_t lock;           // protects the overflow list
+    struct overflow *ov_head;
+    struct overflow *ov_tail;
+    _Atomic size_t ov_count;        // messages on the overflow list
+    size_t ov_total;                // messages that overflowed
 };
 
 struct interthread {
-    flux_t *send;
-    flux_t *recv;
+    int efd;                        // eventfd doorbell
     flux_watcher_t *w;
     struct handler handlers[MAX_HANDLERS];
     int handler_count;
     int verbose;
+    int batch;                      // max messages handled per wakeup
+    uintmax_t count;                // messages handled
+    struct lane lanes[LANE_COUNT];
 };
 
 int interthread_register (struct interthread *it,
                           const char *topic,
                           interthread_msg_handler_f cb,
-                          void *arg)
+                          void *arg,
+                          int flags)
 {
     struct handler *handler;
 
+    if ((flags & ~INTERTHREAD_URGENT)) {
+        errno = EINVAL;
+        return -1;
+    }
     if (it->handler_count == MAX_HANDLERS) {
         errno = ENOSPC;
         return -1;
     }
-    handler = &it->handlers[it->handler_count++];
+    handler = &it->handlers[it->handler_count];
     strlcpy (handler->topic, topic, sizeof (handler->topic));
     handler->cb = cb;
     handler->arg = arg;
-    return 0;
+    handler->lane = (flags & INTERTHREAD_URGENT) ? LANE_URGENT : LANE_NORMAL;
+    return it->handler_count++;
 }
 
-int interthread_send_pack (struct interthread *it,
-                           const char *name,
-                           const char *fmt, ...)
+/* Queue a message on the overflow list of 'lane'.
+ */
+static int overflow_push (struct lane *lane,
+                          struct handler *handler,
+                          void *rec)
 {
-    flux_msg_t *msg;
-    va_list ap;
-    int rc;
+    struct overflow *ov;
 
-    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST))
-        || flux_msg_set_topic (msg, name) < 0)
-        goto error;
+    if (!(ov = calloc (1, sizeof (*ov))))
+        return -1;
+    ov->slot.handler = handler;
+    ov->slot.rec = rec;
+    pthread_mutex_lock (&lane->lock);
+    if (lane->ov_tail)
+        lane->ov_tail->next = ov;
+    else
+        lane->ov_head = ov;
+    lane->ov_tail = ov;
+    atomic_fetch_add (&lane->ov_count, 1);
+    lane->ov_total++;
+    pthread_mutex_unlock (&lane->lock);
+    return 0;
+}
 
-    va_start (ap, fmt);
-    rc = flux_msg_vpack (msg, fmt, ap);
-    va_end (ap);
-    if (rc < 0)
-        goto error;
+/* Take the first message from the overflow list of 'lane'.
+ */
+static bool overflow_pop (struct lane *lane, struct slot *slot)
+{
+    struct overflow *ov;
 
-    if (flux_send_new (it->send, &msg, 0) < 0)
-        goto error;
+    pthread_mutex_lock (&lane->lock);
+    if ((ov = lane->ov_head)) {
+        if (!(lane->ov_head = ov->next))
+            lane->ov_tail = NULL;
+        atomic_fetch_sub (&lane->ov_count, 1);
+    }
+    pthread_mutex_unlock (&lane->lock);
+    if (!ov)
+        return false;
+    *slot = ov->slot;
+    free (ov);
+    return true;
+}
 
+/* N.B. handlers are registered in the shell thread, notify's after the
+ * pmix server thread has started.  An entry is never modified after its
+ * type is returned, and the pmix thread cannot send a message of that type
+ * before the registration that gives it a reason to, so the producer may
+ * read the entry without further synchronization.
+ *
+ * Only the producer adds to the overflow list, so if it is empty here it
+ * stays empty until this call adds to it, and the ring holds everything
+ * sent earlier.
+ */
+int interthread_send (struct interthread *it, int type, void *rec)
+{
+    struct handler *handler;
+    struct lane *lane;
+    uint64_t one = 1;
+    size_t tail;
+    ssize_t n;
+
+    if (type < 0 || type >= MAX_HANDLERS || !it->handlers[type].cb) {
+        errno = EINVAL;
+        return -1;
+    }
+    handler = &it->handlers[type];
+    lane = &it->lanes[handler->lane];
+    tail = atomic_load_explicit (&lane->tail, memory_order_relaxed);
+    if (atomic_load (&lane->ov_count) > 0
+        || tail - atomic_load_explicit (&lane->head, memory_order_acquire)
+           == RING_SIZE) {
+        if (overflow_push (lane, handler, rec) < 0)
+            return -1;
+    }
+    else {
+        lane->ring[tail & (RING_SIZE - 1)].handler = handler;
+        lane->ring[tail & (RING_SIZE - 1)].rec = rec;
+        atomic_store_explicit (&lane->tail, tail + 1, memory_order_release);
+    }
+    /* The message is queued, so it now belongs to the shell thread, even
+     * if the doorbell fails.  It can only fail with EAGAIN when the counter
+     * is about to overflow, in which case a wakeup is pending anyway.
+     */
+    n = write (it->efd, &one, sizeof (one));
+    (void)n;
     return 0;
-error:
-    flux_msg_decref (msg);
-    return -1;
+}
+
+/* Take the next message from the highest priority lane that has one.
+ * Return false if all lanes are empty.
+ */
+static bool interthread_next (struct interthread *it, struct slot *slot)
+{
+    for (int i = 0; i < LANE_COUNT; i++) {
+        struct lane *lane = &it->lanes[i];
+        size_t head;
+        size_t tail;
+
+        head = atomic_load_explicit (&lane->head, memory_order_relaxed);
+        tail = atomic_load_explicit (&lane->tail, memory_order_acquire);
+        if (head != tail) {
+            size_t depth = tail - head + atomic_load (&lane->ov_count);
+            if (depth > lane->max_depth)
+                lane->max_depth = depth;
+            *slot = lane->ring[head & (RING_SIZE - 1)];
+            atomic_store_explicit (&lane->head,
+                                   head + 1,
+                                   memory_order_release);
+            return true;
+        }
+        /* The ring is empty, so anything on the overflow list is next.
+         */
+        if (atomic_load (&lane->ov_count) > 0 && overflow_pop (lane, slot))
+            return true;
+    }
+    return false;
 }
 
 static void interthread_recv (flux_reactor_t *r,
@@ -89,40 +258,55 @@ static void interthread_recv (flux_reactor_t *r,
                               void *arg)
 {
     struct interthread *it = arg;
-    flux_msg_t *msg;
-    const char *topic;
-    int i;
+    struct slot slot;
+    uint64_t count;
+    int n;
 
-    if (!(msg = flux_recv (it->recv, FLUX_MATCH_ANY, 0)))
+    if (read (it->efd, &count, sizeof (count)) < 0)
         return;
-    if (flux_msg_get_topic (msg, &topic) < 0) {
-        shell_warn ("interthread receive decode error - message dropped");
-        flux_msg_decref (msg);
-        return;
-    }
-    if (it->verbose > 1) {
-        const char *payload;
-        if (flux_msg_get_payload (msg, (const void **)&payload, NULL) == 0)
-            shell_trace ("pmix server %s %s", topic, payload);
+    /* Lanes are checked again before each message, so an urgent message
+     * sent while a batch is in progress overtakes the rest of the batch.
+     */
+    for (n = 0; n < it->batch && interthread_next (it, &slot); n++) {
+        if (it->verbose > 1)
+            shell_trace ("pmix server %s", slot.handler->topic);
+        slot.handler->cb (slot.rec, slot.handler->arg);
     }
-    for (i = 0; i < it->handler_count; i++) {
-        if (!strcmp (topic, it->handlers[i].topic))
-            break;
+    it->count += n;
+    /* If the batch filled up, messages may remain.  Ring the doorbell so
+     * the reactor comes back.  A spurious wakeup here is harmless.
+     */
+    if (n == it->batch) {
+        uint64_t one = 1;
+        if (write (it->efd, &one, sizeof (one)) < 0)
+            shell_warn ("interthread: error re-arming doorbell");
     }
-    if (i < it->handler_count)
-        it->handlers[i].cb (msg, it->handlers[i].arg);
-    else
-        shell_warn ("unhandled interthread topic %s", topic);
-    flux_msg_decref (msg);
 }
 
 void interthread_destroy (struct interthread *it)
 {
     if (it) {
         int saved_errno = errno;
+        if (it->count > 0) {
+            shell_debug ("interthread: %ju messages, max queue depth"
+                         " urgent=%zu normal=%zu, overflowed %zu",
+                         it->count,
+                         it->lanes[LANE_URGENT].max_depth,
+                         it->lanes[LANE_NORMAL].max_depth,
+                         it->lanes[LANE_URGENT].ov_total
+                         + it->lanes[LANE_NORMAL].ov_total);
+        }
         flux_watcher_destroy (it->w);
-        flux_close (it->send);
-        flux_close (it->recv);
+        if (it->efd >= 0)
+            close (it->efd);
+        for (int i = 0; i < LANE_COUNT; i++) {
+            struct overflow *ov;
+            while ((ov = it->lanes[i].ov_head)) {
+                it->lanes[i].ov_head = ov->next;
+                free (ov);
+            }
+            pthread_mutex_destroy (&it->lanes[i].lock);
+        }
         free (it);
         errno = saved_errno;
     }
@@ -135,13 +319,30 @@ struct interthread *interthread_create (flux_shell_t *shell)
 
     if (!(it = calloc (1, sizeof (*it))))
         return NULL;
-    if (!(it->send = flux_open ("interthread://pmix", 0))
-        || !(it->recv = flux_open ("interthread://pmix", 0))
-        || !(it->w = flux_handle_watcher_create (flux_get_reactor (h),
-                                                 it->recv,
-                                                 FLUX_POLLIN,
-                                                 interthread_recv,
-                                                 it)))
+    it->efd = -1;
+    for (int i = 0; i < LANE_COUNT; i++) {
+        atomic_init (&it->lanes[i].head, 0);
+        atomic_init (&it->lanes[i].tail, 0);
+        atomic_init (&it->lanes[i].ov_count, 0);
+        pthread_mutex_init (&it->lanes[i].lock, NULL);
+    }
+    it->batch = DEFAULT_BATCH;
+    if (flux_shell_getopt_unpack (shell,
+                                  "pmix",
+                                  "{s?{s?i}}",
+                                  "interthread",
+                                    "batch", &it->batch) < 0
+        || it->batch < 1) {
+        shell_warn ("pmix.interthread.batch must be an integer >= 1");
+        errno = EINVAL;
+        goto error;
+    }
+    if ((it->efd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0
+        || !(it->w = flux_fd_watcher_create (flux_get_reactor (h),
+                                             it->efd,
+                                             FLUX_POLLIN,
+                                             interthread_recv,
+                                             it)))
         goto error;
     flux_watcher_start (it->w);
     (void)flux_shell_getopt_unpack (shell, "verbose", "i", &it->verbose);
@@ -16,16 +16,30 @@
 struct interthread *interthread_create (flux_shell_t *shell);
 void interthread_destroy (struct interthread *it);
 
-typedef void (*interthread_msg_handler_f)(const flux_msg_t *msg, void *arg);
-
+/* Messages are heap-allocated call records, passed by pointer between
+ * threads of the same process without serialization.  The handler takes
+ * ownership of 'rec'.
+ */
+typedef void (*interthread_msg_handler_f)(void *rec, void *arg);
+
+enum {
+    INTERTHREAD_URGENT = 1,     // handle ahead of other pending messages
+};
+
+/* Register a handler for messages named 'topic' (used in traces).
+ * Return the message type to pass to interthread_send(), or -1 on error.
+ */
 int interthread_register (struct interthread *it,
                           const char *topic,
                           interthread_msg_handler_f cb,
-                          void *arg);
-
-int interthread_send_pack (struct interthread *it,
-                           const char *name,
-                           const char *fmt, ...);
+                          void *arg,
+                          int flags);
+
+/* Send 'rec' to the handler of message 'type' in the shell thread.
+ * On success, ownership of 'rec' passes to the handler.  On failure,
+ * the caller still owns it.
+ */
+int interthread_send (struct interthread *it, int type, void *rec);
 
 #endif // _PX_INTERTHREAD_H
 
@@ -188,6 +188,13 @@ static int set_proc_infos (struct infovec *iv,
     return 0;
 }
 
+static void fence_complete_cb (void *arg)
+{
+    struct px *px = arg;
+
+    dmodex_cache_clear (px->dmodex);
+}
+
 static int px_init (flux_plugin_t *p,
                     const char *topic,
                     flux_plugin_arg_t *arg,
@@ -261,6 +268,7 @@ static int px_init (flux_plugin_t *p,
         return -1;
     }
     server_callbacks.direct_modex = dmodex_server_cb;
+    fence_set_complete_cb (px->fence, fence_complete_cb, px);
 
     strlcpy (info[0].key, PMIX_SERVER_TMPDIR, sizeof (info[0].key));
     info[0].value.type = PMIX_STRING;
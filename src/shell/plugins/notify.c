@@ -33,6 +33,7 @@
 struct notify {
     flux_shell_t *shell;
     struct interthread *it;
+    int upcall_type;                // interthread message type
     int id;
 };
 
@@ -41,69 +42,50 @@ struct notify {
  */
 static struct notify *global_notify_ctx;
 
-static void notify_shell_cb (const flux_msg_t *msg, void *arg)
-{
-    int id;
+struct notify_call {
     int status;
-    json_t *xsource;
-    json_t *xinfo;
-    json_t *xresults;
-    json_t *xcbfunc;
-    json_t *xcbdata;
     pmix_proc_t source;
-    pmix_info_t *info = NULL;
-    size_t ninfo = 0;
-    pmix_info_t *results = NULL;
-    size_t nresults = 0;
-    pmix_event_notification_cbfunc_fn_t cbfunc;
-    void *cbdata;
-    int i;
-    const char *message = NULL;
+    pmix_info_t *info;
+    size_t ninfo;
+};
 
-    if (flux_msg_unpack (msg,
-                         "{s:i s:i s:o s:o s:o s:o s:o}",
-                         "id", &id,
-                         "status", &status,
-                         "source", &xsource,
-                         "info", &xinfo,
-                         "results", &xresults,
-                         "cbfunc", &xcbfunc,
-                         "cbdata", &xcbdata) < 0
-        || codec_proc_decode (xsource, &source) < 0
-        || codec_info_array_decode (xinfo, &info, &ninfo) < 0
-        || codec_info_array_decode (xresults, &results, &nresults) < 0
-        || codec_pointer_decode (xcbfunc, (void **)&cbfunc) < 0
-        || codec_pointer_decode (xcbdata, &cbdata) < 0) {
-        shell_warn ("error unpacking interthread abort_upcall message");
-        goto done;
+static void notify_call_destroy (struct notify_call *ncall)
+{
+    if (ncall) {
+        int saved_errno = errno;
+        codec_info_array_free (ncall->info, ncall->ninfo);
+        free (ncall);
+        errno = saved_errno;
     }
-    for (i = 0; i < ninfo; i++) {
-        if (!strcmp (info[i].key, PMIX_EVENT_TEXT_MESSAGE)) {
-            if (info[i].value.type == PMIX_STRING)
-                message = info[i].value.data.string;
+}
+
+static void notify_shell_cb (void *rec, void *arg)
+{
+    struct notify_call *ncall = rec;
+    const char *message = NULL;
+    int i;
+
+    for (i = 0; i < ncall->ninfo; i++) {
+        if (!strcmp (ncall->info[i].key, PMIX_EVENT_TEXT_MESSAGE)) {
+            if (ncall->info[i].value.type == PMIX_STRING)
+                message = ncall->info[i].value.data.string;
         }
     }
     shell_warn ("notify source=%s.%d event-status=%d%s%s",
-               source.nspace,
-               source.rank,
-               status,
+               ncall->source.nspace,
+               ncall->source.rank,
+               ncall->status,
                message ? " " : "",
                message ? message : "");
-#if 0
-    /* Calling the callback seems to cause a segfault in
-     * the server progress_local_event_hdlr().  Perhaps we're doing it wrong.
-     * In test, PMIx_Notify_event() is released anyway, contrary to v5 spec.
-     * Revisit if that test starts hanging.
-     */
-    if (cbfunc)
-        cbfunc (PMIX_EVENT_ACTION_COMPLETE, NULL, 0, NULL, cbdata, NULL);
-#endif
-done:
-    codec_info_array_destroy (info, ninfo);
-    codec_info_array_destroy (results, nresults);
+    notify_call_destroy (ncall);
 }
 
-
+/* N.B. Calling 'cbfunc' seems to cause a segfault in the server
+ * progress_local_event_hdlr().  Perhaps we're doing it wrong.
+ * In test, PMIx_Notify_event() is released anyway, contrary to v5 spec.
+ * Revisit if that test starts hanging.  Since it is not called, it is not
+ * passed to the shell thread, nor are the results.
+ */
 static void notify_server_cb (size_t evhdlr_registration_id,
                              pmix_status_t status,
                              const pmix_proc_t *source,
@@ -115,34 +97,23 @@ static void notify_server_cb (size_t evhdlr_registration_id,
                              void *cbdata)
 {
     struct notify *notify = global_notify_ctx;
+    struct notify_call *ncall;
 
-    json_t *xsource = NULL;
-    json_t *xinfo = NULL;
-    json_t *xresults = NULL;
-    json_t *xcbfunc = NULL;
-    json_t *xcbdata = NULL;
-
-    if (!(xsource = codec_proc_encode (source))
-        || !(xinfo = codec_info_array_encode (info, ninfo))
-        || !(xresults = codec_info_array_encode (results, nresults))
-        || !(xcbfunc = codec_pointer_encode (cbfunc))
-        || !(xcbdata = codec_pointer_encode (cbdata))
-        || interthread_send_pack (notify->it,
-                                  "notify_upcall",
-                                  "{s:i s:i s:O s:O s:O s:O s:O}",
-                                  "id", evhdlr_registration_id,
-                                  "status", status,
-                                  "source", xsource,
-                                  "info", xinfo,
-                                  "results", xresults,
-                                  "cbfunc", xcbfunc,
-                                  "cbdata", xcbdata) < 0)
-        fprintf (stderr, "error sending notify_upcall interthread message\n");
-    json_decref (xsource);
-    json_decref (xinfo);
-    json_decref (xresults);
-    json_decref (xcbfunc);
-    json_decref (xcbdata);
+    if (!(ncall = calloc (1, sizeof (*ncall))))
+        goto error;
+    ncall->status = status;
+    ncall->source = *source;
+    if (ninfo > 0) {
+        if (!(ncall->info = codec_info_array_dup (info, ninfo)))
+            goto error;
+        ncall->ninfo = ninfo;
+    }
+    if (interthread_send (notify->it, notify->upcall_type, ncall) < 0)
+        goto error;
+    return;
+error:
+    fprintf (stderr, "error sending notify_upcall interthread message\n");
+    notify_call_destroy (ncall);
 }
 
 void notify_destroy (struct notify *notify)
@@ -165,6 +136,16 @@ struct notify *notify_create (flux_shell_t *shell, struct interthread *it)
         return NULL;
     notify->shell = shell;
     notify->it = it;
+    if ((notify->upcall_type = interthread_register (it,
+                                                     "notify_upcall",
+                                                     notify_shell_cb,
+                                                     notify,
+                                                     INTERTHREAD_URGENT)) < 0)
+        goto error;
+    /* Set before registering, since pmix may call notify_server_cb()
+     * in its thread before PMIx_Register_event_handler() returns.
+     */
+    global_notify_ctx = notify;
 #if PMIX_VERSION_MAJOR < 4
     PMIx_Register_event_handler (NULL,
                                  0,
@@ -186,9 +167,6 @@ struct notify *notify_create (flux_shell_t *shell, struct interthread *it)
         goto error;
     }
 #endif
-    if (interthread_register (it, "notify_upcall", notify_shell_cb, notify) < 0)
-        goto error;
-    global_notify_ctx = notify;
     return notify;
 error:
     notify_destroy (notify);
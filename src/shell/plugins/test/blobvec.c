@@ -0,0 +1,294 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "src/common/libtap/tap.h"
+
+#include "blobvec.h"
+
+void basic (void)
+{
+    struct blobvec *bv;
+    const void *buf;
+    size_t size;
+    const char *seg;
+    uint32_t id;
+    void *data;
+
+    lives_ok ({ blobvec_destroy (NULL); },
+        "blobvec_destroy bv=NULL doesn't crash");
+
+    if (!(bv = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+    ok (blobvec_count (bv) == 0 && blobvec_datasize (bv) == 0,
+        "new blobvec is empty");
+    ok (blobvec_first (bv, NULL, NULL) == NULL,
+        "blobvec_first returns NULL on empty blobvec");
+    ok (blobvec_encode (bv, &buf, &size) == 0 && size == 0,
+        "blobvec_encode returns zero size on empty blobvec");
+
+    ok (blobvec_append (bv, 3, "foo", 4) == 0,
+        "blobvec_append id=3 foo works");
+    ok (blobvec_append (bv, 4, NULL, 0) == 0,
+        "blobvec_append id=4 empty segment works");
+    ok (blobvec_append (bv, 5, "barbaz", 7) == 0,
+        "blobvec_append id=5 barbaz works");
+    ok (blobvec_count (bv) == 3,
+        "blobvec_count returns 3");
+    ok (blobvec_datasize (bv) == 11,
+        "blobvec_datasize returns 11");
+
+    seg = blobvec_first (bv, &id, &size);
+    ok (seg != NULL && id == 3 && size == 4 && !strcmp (seg, "foo"),
+        "blobvec_first returns first segment");
+    seg = blobvec_next (bv, &id, &size);
+    ok (seg != NULL && id == 4 && size == 0,
+        "blobvec_next returns empty second segment");
+    seg = blobvec_next (bv, &id, &size);
+    ok (seg != NULL && id == 5 && size == 7 && !strcmp (seg, "barbaz"),
+        "blobvec_next returns third segment");
+    ok (blobvec_next (bv, &id, &size) == NULL,
+        "blobvec_next returns NULL after last segment");
+
+    ok (blobvec_encode_prefix (bv, 2, &buf, &size) == 0
+        && size == 2 * 8 + 4,
+        "blobvec_encode_prefix count=2 returns first two segments");
+    ok (blobvec_encode_prefix (bv, 0, &buf, &size) == 0 && size == 0,
+        "blobvec_encode_prefix count=0 returns zero size");
+    errno = 0;
+    ok (blobvec_encode_prefix (bv, 4, &buf, &size) < 0 && errno == EINVAL,
+        "blobvec_encode_prefix count=4 fails with EINVAL");
+
+    data = NULL;
+    ok (blobvec_decode (bv, &data, &size) == 0
+        && size == 11
+        && memcmp (data, "foo\0barbaz\0", 11) == 0,
+        "blobvec_decode concatenates segments");
+    free (data);
+
+    blobvec_destroy (bv);
+}
+
+void extend (void)
+{
+    struct blobvec *bv1;
+    struct blobvec *bv2;
+    const void *buf;
+    size_t size;
+    uint32_t id;
+    int errors;
+    char seg[64];
+
+    if (!(bv1 = blobvec_create ())
+        || !(bv2 = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+
+    errors = 0;
+    for (int i = 0; i < 1000; i++) {
+        snprintf (seg, sizeof (seg), "segment-%d", i);
+        if (blobvec_append (bv1, i, seg, strlen (seg) + 1) < 0)
+            errors++;
+    }
+    ok (errors == 0,
+        "blobvec_append 1000x works");
+    ok (blobvec_encode (bv1, &buf, &size) == 0,
+        "blobvec_encode works");
+    ok (blobvec_extend (bv2, buf, size) == 0
+        && blobvec_extend (bv2, buf, size) == 0,
+        "blobvec_extend works twice");
+    ok (blobvec_count (bv2) == 2000,
+        "blobvec_count returns 2000");
+    ok (blobvec_datasize (bv2) == 2 * blobvec_datasize (bv1),
+        "blobvec_datasize is doubled");
+
+    errors = 0;
+    int i = 0;
+    const char *s = blobvec_first (bv2, &id, &size);
+    while (s) {
+        snprintf (seg, sizeof (seg), "segment-%d", i % 1000);
+        if (id != i % 1000 || size != strlen (seg) + 1 || strcmp (s, seg))
+            errors++;
+        s = blobvec_next (bv2, &id, &size);
+        i++;
+    }
+    ok (errors == 0 && i == 2000,
+        "extended blobvec has the correct content");
+
+    /* truncated input
+     */
+    ok (blobvec_encode (bv1, &buf, &size) == 0,
+        "blobvec_encode works");
+    errno = 0;
+    ok (blobvec_extend (bv2, buf, size - 1) < 0 && errno == EPROTO,
+        "blobvec_extend fails with EPROTO on truncated segment");
+    errno = 0;
+    ok (blobvec_extend (bv2, buf, 5) < 0 && errno == EPROTO,
+        "blobvec_extend fails with EPROTO on truncated header");
+    ok (blobvec_count (bv2) == 2000,
+        "blobvec was not modified by failed blobvec_extend");
+
+    blobvec_destroy (bv1);
+    blobvec_destroy (bv2);
+}
+
+void equal (void)
+{
+    struct blobvec *bv1;
+    struct blobvec *bv2;
+
+    if (!(bv1 = blobvec_create ())
+        || !(bv2 = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+    ok (blobvec_equal (bv1, bv2),
+        "blobvec_equal is true for empty blobvecs");
+    if (blobvec_append (bv1, 1, "foo", 4) < 0
+        || blobvec_append (bv1, 2, "bar", 4) < 0
+        || blobvec_append (bv2, 2, "bar", 4) < 0
+        || blobvec_append (bv2, 1, "foo", 4) < 0)
+        BAIL_OUT ("could not create test blobvecs");
+    ok (blobvec_equal (bv1, bv2),
+        "blobvec_equal does not depend on segment order");
+    if (blobvec_append (bv1, 3, "baz", 4) < 0
+        || blobvec_append (bv2, 4, "baz", 4) < 0)
+        BAIL_OUT ("could not append to test blobvecs");
+    ok (!blobvec_equal (bv1, bv2),
+        "blobvec_equal depends on segment ids");
+    blobvec_destroy (bv1);
+    blobvec_destroy (bv2);
+
+    if (!(bv1 = blobvec_create ())
+        || !(bv2 = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+    if (blobvec_append (bv1, 1, "ab", 2) < 0
+        || blobvec_append (bv1, 2, "cd", 2) < 0
+        || blobvec_append (bv2, 2, "cd", 2) < 0
+        || blobvec_append (bv2, 1, "ax", 2) < 0)
+        BAIL_OUT ("could not create test blobvecs");
+    ok (!blobvec_equal (bv1, bv2),
+        "blobvec_equal depends on segment data");
+    ok (!blobvec_equal (bv1, NULL),
+        "blobvec_equal is false if one blobvec is NULL");
+    blobvec_destroy (bv1);
+    blobvec_destroy (bv2);
+}
+
+static int free_count;
+
+static void count_free (void *arg)
+{
+    free_count++;
+    free (arg);
+}
+
+void wrap (void)
+{
+    struct blobvec *bv1;
+    struct blobvec *bv2;
+    const void *buf;
+    size_t size;
+    void *cpy;
+    const char *seg;
+    uint32_t id;
+
+    if (!(bv1 = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+    if (blobvec_append (bv1, 1, "foo", 4) < 0
+        || blobvec_append (bv1, 2, "bar", 4) < 0
+        || blobvec_encode (bv1, &buf, &size) < 0)
+        BAIL_OUT ("could not create test blobvec");
+    if (!(cpy = malloc (size)))
+        BAIL_OUT ("out of memory");
+    memcpy (cpy, buf, size);
+
+    free_count = 0;
+    bv2 = blobvec_wrap (cpy, size, count_free, cpy);
+    ok (bv2 != NULL,
+        "blobvec_wrap works");
+    ok (blobvec_count (bv2) == 2 && blobvec_datasize (bv2) == 8,
+        "wrapped blobvec has expected count and size");
+    ok (blobvec_encode (bv2, &buf, &size) == 0 && buf == cpy,
+        "blobvec_encode returns the wrapped buffer");
+    seg = blobvec_first (bv2, &id, &size);
+    ok (seg != NULL && id == 1 && size == 4 && !strcmp (seg, "foo"),
+        "blobvec_first returns first segment of wrapped buffer");
+    errno = 0;
+    ok (blobvec_append (bv2, 3, "baz", 4) < 0 && errno == EROFS,
+        "blobvec_append on wrapped blobvec fails with EROFS");
+    errno = 0;
+    ok (blobvec_extend (bv2, cpy, 12) < 0 && errno == EROFS,
+        "blobvec_extend on wrapped blobvec fails with EROFS");
+
+    ok (blobvec_incref (bv2) == bv2,
+        "blobvec_incref returns the blobvec");
+    blobvec_decref (bv2);
+    ok (free_count == 0,
+        "blobvec_decref with remaining reference does not free buffer");
+    blobvec_destroy (bv2);
+    ok (free_count == 1,
+        "blobvec_destroy of last reference calls free function");
+
+    errno = 0;
+    ok (blobvec_wrap ("\0\0\0\0\0\0\0\5foo", 11, count_free, NULL) == NULL
+        && errno == EPROTO,
+        "blobvec_wrap fails with EPROTO on truncated segment");
+
+    blobvec_destroy (bv1);
+}
+
+void badarg (void)
+{
+    struct blobvec *bv;
+    const void *buf;
+    size_t size;
+    void *data;
+
+    if (!(bv = blobvec_create ()))
+        BAIL_OUT ("blobvec_create failed");
+
+    errno = 0;
+    ok (blobvec_append (NULL, 0, "foo", 4) < 0 && errno == EINVAL,
+        "blobvec_append bv=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobvec_append (bv, 0, NULL, 4) < 0 && errno == EINVAL,
+        "blobvec_append data=NULL size=4 fails with EINVAL");
+    errno = 0;
+    ok (blobvec_extend (NULL, "foo", 4) < 0 && errno == EINVAL,
+        "blobvec_extend bv=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobvec_encode (NULL, &buf, &size) < 0 && errno == EINVAL,
+        "blobvec_encode bv=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobvec_decode (NULL, &data, &size) < 0 && errno == EINVAL,
+        "blobvec_decode bv=NULL fails with EINVAL");
+
+    blobvec_destroy (bv);
+}
+
+int main (int argc, char **argv)
+{
+    plan (NO_PLAN);
+
+    basic ();
+    extend ();
+    equal ();
+    wrap ();
+    badarg ();
+
+    done_testing ();
+    return 0;
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,249 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <jansson.h>
+
+#include "src/common/libtap/tap.h"
+
+#include "tree.h"
+
+void kary (void)
+{
+    ok (tree_kary_parent (2, 0) == TREE_NONE,
+        "k=2: rank 0 has no parent");
+    ok (tree_kary_parent (2, 1) == 0
+        && tree_kary_parent (2, 2) == 0
+        && tree_kary_parent (2, 3) == 1
+        && tree_kary_parent (2, 6) == 2,
+        "k=2: parents are correct");
+    ok (tree_kary_parent (1, 4) == 3,
+        "k=1: parent is the previous rank");
+    ok (tree_kary_child (2, 5, 1, 0) == 3
+        && tree_kary_child (2, 5, 1, 1) == 4
+        && tree_kary_child (2, 5, 2, 0) == TREE_NONE,
+        "k=2 size=5: children are correct");
+    ok (tree_kary_child (2, 5, 0, 2) == TREE_NONE,
+        "k=2: there is no third child");
+    ok (tree_kary_child_count (2, 5, 0) == 2
+        && tree_kary_child_count (2, 5, 1) == 2
+        && tree_kary_child_count (2, 5, 2) == 0,
+        "k=2 size=5: child counts are correct");
+    ok (tree_kary_child_count (3, 1, 0) == 0,
+        "size=1: rank 0 has no children");
+}
+
+/* Check that the balanced tree of every rank is one tree:  every rank
+ * but 0 has a parent, the parent's child count agrees, no rank has more
+ * than k children, and every rank reaches rank 0.
+ */
+static int check_balanced (int k, int size, const int *ntasks)
+{
+    uint32_t *parent = calloc (size, sizeof (parent[0]));
+    int *count = calloc (size, sizeof (count[0]));
+    int *children = calloc (size, sizeof (children[0]));
+    int rc = -1;
+
+    if (!parent || !count || !children)
+        BAIL_OUT ("out of memory");
+    for (int i = 0; i < size; i++) {
+        if (tree_balanced (k, size, ntasks, i, &parent[i], &count[i]) < 0)
+            goto done;
+    }
+    if (parent[0] != TREE_NONE)
+        goto done;
+    for (int i = 1; i < size; i++) {
+        if (parent[i] >= size)
+            goto done;
+        children[parent[i]]++;
+    }
+    for (int i = 0; i < size; i++) {
+        uint32_t r = i;
+        int hops = 0;
+
+        if (children[i] != count[i] || count[i] > k)
+            goto done;
+        while (r != 0 && hops++ < size)
+            r = parent[r];
+        if (r != 0)
+            goto done;
+    }
+    rc = 0;
+done:
+    free (children);
+    free (count);
+    free (parent);
+    return rc;
+}
+
+void balanced (void)
+{
+    int ntasks[] = { 1, 1, 1, 8, 1 };
+    int big[100];
+    uint32_t parent;
+    int count;
+
+    ok (tree_balanced (2, 5, ntasks, 0, &parent, &count) == 0
+        && parent == TREE_NONE
+        && count == 2,
+        "rank 0 is the root");
+    ok (tree_balanced (2, 5, ntasks, 3, &parent, &count) == 0
+        && parent == 0
+        && count == 0,
+        "the rank with the most tasks is a child of rank 0");
+    ok (tree_balanced (2, 5, ntasks, 1, &parent, &count) == 0
+        && parent == 0
+        && count == 2,
+        "the light subtree gets the remaining ranks");
+    ok (tree_balanced (2, 5, ntasks, 4, &parent, &count) == 0
+        && parent == 1,
+        "a rank is attached to the lightest subtree");
+    ok (check_balanced (2, 5, ntasks) == 0,
+        "k=2 size=5: the tree is consistent");
+
+    for (int i = 0; i < 100; i++)
+        big[i] = 1 + (i * 7919) % 13;
+    ok (check_balanced (3, 100, big) == 0,
+        "k=3 size=100: the tree is consistent");
+    ok (check_balanced (1, 100, big) == 0,
+        "k=1 size=100: the tree is consistent");
+    ok (check_balanced (100, 100, big) == 0,
+        "k=100 size=100: the tree is consistent");
+    ok (check_balanced (2, 1, big) == 0,
+        "k=2 size=1: the tree is consistent");
+
+    errno = 0;
+    ok (tree_balanced (0, 5, ntasks, 0, &parent, &count) < 0
+        && errno == EINVAL,
+        "tree_balanced k=0 fails with EINVAL");
+    errno = 0;
+    ok (tree_balanced (2, 5, ntasks, 5, &parent, &count) < 0
+        && errno == EINVAL,
+        "tree_balanced rank=size fails with EINVAL");
+}
+
+/* Create an overlay topology node with 'n' children.
+ */
+static json_t *node (int rank, int n, ...)
+{
+    json_t *o;
+    json_t *children;
+    va_list ap;
+
+    if (!(o = json_object ())
+        || !(children = json_array ())
+        || json_object_set_new (o, "rank", json_integer (rank)) < 0
+        || json_object_set_new (o, "children", children) < 0)
+        BAIL_OUT ("error creating topology node");
+    va_start (ap, n);
+    for (int i = 0; i < n; i++) {
+        if (json_array_append_new (children, va_arg (ap, json_t *)) < 0)
+            BAIL_OUT ("error creating topology node");
+    }
+    va_end (ap);
+    return o;
+}
+
+void topology (void)
+{
+    json_t *topo;
+    uint32_t parent;
+    int count;
+    int brokers1[] = { 0, 1, 3 };
+    int brokers2[] = { 0, 3 };
+    int brokers3[] = { 2, 3 };
+    int brokers4[] = { 0, 4 };
+
+    /* 0 -> (1 -> (3), 2)
+     */
+    topo = node (0, 2, node (1, 1, node (3, 0)), node (2, 0));
+    if (json_object_set_new (topo, "size", json_integer (4)) < 0)
+        BAIL_OUT ("error creating topology");
+
+    ok (tree_topology (topo, 3, brokers1, 0, &parent, &count) == 0
+        && parent == TREE_NONE
+        && count == 1,
+        "shell on broker 0 is the root");
+    ok (tree_topology (topo, 3, brokers1, 2, &parent, &count) == 0
+        && parent == 1
+        && count == 0,
+        "shell on broker 3 is a child of the shell on broker 1");
+
+    ok (tree_topology (topo, 2, brokers2, 1, &parent, &count) == 0
+        && parent == 0,
+        "shell with no ancestor broker in the job skips to the nearest one");
+
+    ok (tree_topology (topo, 2, brokers3, 1, &parent, &count) == 0
+        && parent == 0,
+        "shell with no ancestor in the job is a child of rank 0");
+    ok (tree_topology (topo, 2, brokers3, 0, &parent, &count) == 0
+        && parent == TREE_NONE
+        && count == 1,
+        "rank 0 is the root when it isn't on broker 0");
+
+    errno = 0;
+    ok (tree_topology (topo, 2, brokers4, 0, &parent, &count) < 0
+        && errno == EPROTO,
+        "tree_topology fails with EPROTO on a broker outside the topology");
+    json_decref (topo);
+
+    topo = json_object ();
+    errno = 0;
+    ok (tree_topology (topo, 2, brokers1, 0, &parent, &count) < 0
+        && errno == EPROTO,
+        "tree_topology fails with EPROTO on a malformed topology");
+    json_decref (topo);
+
+    errno = 0;
+    ok (tree_topology (NULL, 2, brokers1, 0, &parent, &count) < 0
+        && errno == EINVAL,
+        "tree_topology topo=NULL fails with EINVAL");
+}
+
+void autotune (void)
+{
+    ok (tree_depth (2, 1) == 0
+        && tree_depth (2, 3) == 1
+        && tree_depth (2, 4) == 2
+        && tree_depth (4, 21) == 2
+        && tree_depth (4, 22) == 3,
+        "tree_depth is correct");
+    ok (tree_depth (1, 5) == 4,
+        "tree_depth k=1 is size - 1");
+    ok (tree_autotune_fanout (10, 1.0, 0) == 9,
+        "latency bound cost picks a flat tree");
+    ok (tree_autotune_fanout (64, 0, 1.0) == 2,
+        "message bound cost picks a narrow tree");
+    ok (tree_autotune_fanout (1000, 1.0, 0) == 32,
+        "ties go to the smallest fanout");
+    ok (tree_autotune_initial_fanout (1) == 2
+        && tree_autotune_initial_fanout (100) == 10
+        && tree_autotune_initial_fanout (1000000) == 64,
+        "initial fanout makes a two level tree, within limits");
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    kary ();
+    balanced ();
+    topology ();
+    autotune ();
+
+    done_testing ();
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,113 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "src/common/libtap/tap.h"
+
+#include "zcodec.h"
+
+void roundtrip (void)
+{
+    char data[8192];
+    void *zdata;
+    size_t zsize;
+    size_t size;
+    char out[8192];
+
+    for (int i = 0; i < sizeof (data); i += 32)
+        snprintf (data + i, 32, "pml.ucx.%022d", i);
+
+    ok (zcodec_compress (data, sizeof (data), &zdata, &zsize) == 0,
+        "zcodec_compress works");
+    ok (zsize < sizeof (data) / 2,
+        "redundant data is compressed (%zu -> %zu)", sizeof (data), zsize);
+    ok (zcodec_size (zdata, zsize, &size) == 0 && size == sizeof (data),
+        "zcodec_size returns the uncompressed size");
+    ok (zcodec_uncompress (zdata, zsize, out, size) == 0
+        && memcmp (out, data, sizeof (data)) == 0,
+        "zcodec_uncompress restores the data");
+    errno = 0;
+    ok (zcodec_uncompress (zdata, zsize - 1, out, size) < 0
+        && errno == EPROTO,
+        "zcodec_uncompress fails with EPROTO on truncated stream");
+    errno = 0;
+    ok (zcodec_uncompress (zdata, zsize, out, size - 1) < 0
+        && errno == EINVAL,
+        "zcodec_uncompress fails with EINVAL on wrong size");
+    free (zdata);
+
+    ok (zcodec_compress (NULL, 0, &zdata, &zsize) == 0,
+        "zcodec_compress works on empty data");
+    ok (zcodec_size (zdata, zsize, &size) == 0 && size == 0,
+        "zcodec_size returns zero");
+    ok (zcodec_uncompress (zdata, zsize, out, 0) == 0,
+        "zcodec_uncompress works on empty data");
+    free (zdata);
+}
+
+void badarg (void)
+{
+    void *zdata;
+    size_t zsize;
+    size_t size;
+
+    errno = 0;
+    ok (zcodec_compress (NULL, 1, &zdata, &zsize) < 0 && errno == EINVAL,
+        "zcodec_compress data=NULL size=1 fails with EINVAL");
+    errno = 0;
+    ok (zcodec_size ("abc", 3, &size) < 0 && errno == EPROTO,
+        "zcodec_size fails with EPROTO on truncated header");
+    errno = 0;
+    ok (zcodec_size ("abcd", 4, NULL) < 0 && errno == EINVAL,
+        "zcodec_size size=NULL fails with EINVAL");
+    errno = 0;
+    ok (zcodec_size ("\xff\xff\xff\xff" "abcd", 8, &size) < 0
+        && errno == EPROTO,
+        "zcodec_size fails with EPROTO on an impossible size");
+}
+
+void zeros (void)
+{
+    size_t len = 1024 * 1024;
+    char *data = calloc (1, len);
+    void *zdata;
+    size_t zsize;
+    size_t size;
+
+    if (!data)
+        BAIL_OUT ("out of memory");
+    ok (zcodec_compress (data, len, &zdata, &zsize) == 0,
+        "zcodec_compress works on 1MiB of zeros");
+    ok (zcodec_size (zdata, zsize, &size) == 0 && size == len,
+        "zcodec_size accepts the size (%zu -> %zu)", len, zsize);
+    free (zdata);
+    free (data);
+}
+
+int main (int argc, char **argv)
+{
+    plan (NO_PLAN);
+
+    roundtrip ();
+    badarg ();
+    zeros ();
+
+    done_testing ();
+    return 0;
+}
+
+// vi:ts=4 sw=4 expandtab
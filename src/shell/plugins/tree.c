@@ -0,0 +1,299 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* tree.c - exchange tree shapes
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <jansson.h>
+
+#include "tree.h"
+
+#define MAX_AUTO_TREE_K 64
+
+/* borrow a couple of well tested functions from kary.c in flux-core
+ */
+// Return the parent of i or TREE_NONE if i has no parent.
+uint32_t tree_kary_parent (int k, uint32_t i)
+{
+    if (i == 0 || k <= 0)
+        return TREE_NONE;
+    if (k == 1)
+        return i - 1;
+    return (k + (i + 1) - 2) / k - 1;
+}
+// Return the jth child of i or TREE_NONE if i has no such child.
+uint32_t tree_kary_child (int k, uint32_t size, uint32_t i, int j)
+{
+    uint32_t n;
+
+    if (k > 0 && j >= 0 && j < k) {
+        n = k*(i + 1) - (k - 2) + j - 1;
+        if (n < size)
+            return n;
+    }
+    return TREE_NONE;
+}
+
+int tree_kary_child_count (int k, uint32_t size, uint32_t rank)
+{
+    int count = 0;
+
+    for (int i = 0; i < k; i++) {
+        if (tree_kary_child (k, size, rank, i) != TREE_NONE)
+            count++;
+    }
+    return count;
+}
+
+struct bnode {
+    int rank;
+    int ntasks;
+    int parent;                     // parent shell rank (-1 if none)
+    int child_count;
+    long weight;                    // tasks in the subtree so far
+};
+
+/* Order shells by task count, largest first, then by rank.
+ */
+static int bnode_cmp (const void *a, const void *b)
+{
+    const struct bnode *n1 = a;
+    const struct bnode *n2 = b;
+
+    if (n1->ntasks != n2->ntasks)
+        return n1->ntasks > n2->ntasks ? -1 : 1;
+    return n1->rank - n2->rank;
+}
+
+/* Restore the order of a min-heap of indexes into nodes[], ordered by
+ * subtree weight, then index, below heap[i].
+ */
+static void bheap_down (struct bnode *nodes, int *heap, int count, int i)
+{
+    for (;;) {
+        int min = i;
+        int tmp;
+
+        for (int c = 2 * i + 1; c <= 2 * i + 2 && c < count; c++) {
+            struct bnode *n1 = &nodes[heap[c]];
+            struct bnode *n2 = &nodes[heap[min]];
+
+            if (n1->weight < n2->weight
+                || (n1->weight == n2->weight && heap[c] < heap[min]))
+                min = c;
+        }
+        if (min == i)
+            break;
+        tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/* Shells are attached in order of decreasing task count.  The tree is
+ * filled level by level, so the candidate parents are the nodes of one
+ * level, whose weights only change as they gain children.  They are kept
+ * in a heap, so building the tree is O(size log size).
+ */
+int tree_balanced (int k,
+                   int size,
+                   const int *ntasks,
+                   int rank,
+                   uint32_t *parent_rank,
+                   int *child_count)
+{
+    struct bnode *nodes;
+    int *heap;                      // candidate parents, by index in nodes[]
+    int count = 0;
+    int level = 1;                  // index in nodes[] of next level
+
+    if (k < 1 || size < 1 || rank < 0 || rank >= size) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(nodes = calloc (size, sizeof (nodes[0])))
+        || !(heap = calloc (size, sizeof (heap[0])))) {
+        free (nodes);
+        return -1;
+    }
+    for (int i = 0; i < size; i++) {
+        nodes[i].rank = i;
+        nodes[i].ntasks = ntasks[i];
+        nodes[i].parent = -1;
+        nodes[i].weight = ntasks[i];
+    }
+    /* Rank 0 stays at the root.
+     */
+    qsort (nodes + 1, size - 1, sizeof (nodes[0]), bnode_cmp);
+    heap[count++] = 0;
+    for (int i = 1; i < size; i++) {
+        struct bnode *parent;
+
+        /* The level is full.  Its children, attached since it was
+         * started, are the next level.
+         */
+        if (count == 0) {
+            for (int j = level; j < i; j++)
+                heap[count++] = j;
+            level = i;
+            for (int j = count / 2 - 1; j >= 0; j--)
+                bheap_down (nodes, heap, count, j);
+        }
+        parent = &nodes[heap[0]];
+        nodes[i].parent = parent->rank;
+        parent->weight += nodes[i].ntasks;
+        if (++parent->child_count == k)
+            heap[0] = heap[--count];
+        bheap_down (nodes, heap, count, 0);
+    }
+    for (int i = 0; i < size; i++) {
+        if (nodes[i].rank == rank) {
+            *parent_rank = nodes[i].parent >= 0 ? nodes[i].parent : TREE_NONE;
+            *child_count = nodes[i].child_count;
+            break;
+        }
+    }
+    free (heap);
+    free (nodes);
+    return 0;
+}
+
+struct topo_ctx {
+    int *shells;                    // broker rank => shell rank (-1 if none)
+    int nbrokers;
+    int rank;                       // this shell's rank
+    int parent;                     // parent shell rank (-1 if none)
+    int child_count;
+};
+
+/* Visit overlay subtree 'node', whose nearest ancestor broker hosting a
+ * shell of this job hosts shell 'ancestor' (-1 if none).  Record the
+ * parent and child count of this shell.
+ */
+static int topo_visit (struct topo_ctx *ctx, json_t *node, int ancestor)
+{
+    int rank;
+    json_t *children = NULL;
+    json_t *child;
+    size_t index;
+    int shell = -1;
+
+    if (json_unpack (node,
+                     "{s:i s?o}",
+                     "rank", &rank,
+                     "children", &children) < 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (rank >= 0 && rank < ctx->nbrokers)
+        shell = ctx->shells[rank];
+    if (shell > 0) {
+        int parent = ancestor >= 0 ? ancestor : 0;
+        if (shell == ctx->rank)
+            ctx->parent = parent;
+        if (parent == ctx->rank)
+            ctx->child_count++;
+    }
+    if (shell >= 0)
+        ancestor = shell;
+    json_array_foreach (children, index, child) {
+        if (topo_visit (ctx, child, ancestor) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+int tree_topology (json_t *topo,
+                   int size,
+                   const int *brokers,
+                   int rank,
+                   uint32_t *parent,
+                   int *child_count)
+{
+    struct topo_ctx ctx = { .rank = rank, .parent = -1 };
+    int rc = -1;
+
+    if (!topo || size < 1 || rank < 0 || rank >= size) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (json_unpack (topo, "{s:i}", "size", &ctx.nbrokers) < 0
+        || ctx.nbrokers < 1) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (!(ctx.shells = malloc (ctx.nbrokers * sizeof (ctx.shells[0]))))
+        return -1;
+    for (int i = 0; i < ctx.nbrokers; i++)
+        ctx.shells[i] = -1;
+    for (int i = 0; i < size; i++) {
+        if (brokers[i] < 0 || brokers[i] >= ctx.nbrokers) {
+            errno = EPROTO;
+            goto done;
+        }
+        ctx.shells[brokers[i]] = i;
+    }
+    if (topo_visit (&ctx, topo, -1) < 0)
+        goto done;
+    *parent = ctx.parent >= 0 ? ctx.parent : TREE_NONE;
+    *child_count = ctx.child_count;
+    rc = 0;
+done:
+    free (ctx.shells);
+    return rc;
+}
+
+int tree_depth (int k, int size)
+{
+    int depth = 0;
+    long level = 1;
+    long count = 1;
+
+    if (k == 1)
+        return size - 1;
+    while (count < size) {
+        level *= k;
+        count += level;
+        depth++;
+    }
+    return depth;
+}
+
+int tree_autotune_fanout (int size, double latency, double msgcost)
+{
+    int best_k = TREE_DEFAULT_K;
+    double best_cost = -1;
+
+    for (int k = 2; k <= size && k <= MAX_AUTO_TREE_K; k++) {
+        double cost = tree_depth (k, size) * (latency + k * msgcost);
+        if (best_cost < 0 || cost < best_cost) {
+            best_cost = cost;
+            best_k = k;
+        }
+    }
+    return best_k;
+}
+
+int tree_autotune_initial_fanout (int size)
+{
+    int k = TREE_DEFAULT_K;
+
+    while (k * k < size && k < MAX_AUTO_TREE_K)
+        k++;
+    return k;
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,79 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_TREE_H
+#define _PX_TREE_H
+
+#include <stdint.h>
+#include <jansson.h>
+
+/* Shapes of the exchange tree over shell ranks, rooted at rank 0.
+ * Every shell computes the whole tree from the same inputs, so all shells
+ * agree on it, and keeps only its own place in it.
+ */
+
+#define TREE_NONE (~(uint32_t)0)
+
+#define TREE_DEFAULT_K 2
+
+/* k-ary tree.  Return the parent, or the jth child, of 'rank', or
+ * TREE_NONE if there is none.
+ */
+uint32_t tree_kary_parent (int k, uint32_t rank);
+uint32_t tree_kary_child (int k, uint32_t size, uint32_t rank, int j);
+int tree_kary_child_count (int k, uint32_t size, uint32_t rank);
+
+/* Tree with fanout k and the depth of a k-ary tree, in which shells are
+ * placed by task count ('ntasks' has one entry per shell rank), which
+ * stands in for the size of their contribution.  The shells with the most
+ * tasks are placed closest to rank 0, and each shell is attached to the
+ * parent at the shallowest level with a free slot whose subtree has the
+ * fewest tasks so far, so the byte volume of the subtrees is balanced.
+ */
+int tree_balanced (int k,
+                   int size,
+                   const int *ntasks,
+                   int rank,
+                   uint32_t *parent,
+                   int *child_count);
+
+/* Tree that follows the broker overlay (TBON) topology 'topo', as returned
+ * by overlay.topology on broker rank 0.  'brokers' maps each shell rank to
+ * its broker rank.  The parent of a shell is the shell on the nearest
+ * ancestor broker that is part of the job, so each exchange request is a
+ * single overlay hop.  Shells with no such ancestor are children of
+ * rank 0.  Fails with EPROTO if 'topo' is malformed or doesn't cover
+ * 'brokers'.
+ */
+int tree_topology (json_t *topo,
+                   int size,
+                   const int *brokers,
+                   int rank,
+                   uint32_t *parent,
+                   int *child_count);
+
+/* Number of hops from the root to the deepest leaf of a k-ary tree.
+ */
+int tree_depth (int k, int size);
+
+/* Pick the fanout that minimizes the time for a message to traverse a
+ * k-ary tree, where each hop costs 'latency' plus 'msgcost' for each child
+ * handled by the parent.
+ */
+int tree_autotune_fanout (int size, double latency, double msgcost);
+
+/* Fanout to start autotune with, based on job size alone:  a two level
+ * tree.
+ */
+int tree_autotune_initial_fanout (int size);
+
+#endif // _PX_TREE_H
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,114 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* zcodec.c - zlib compression of opaque data blobs
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+
+#include "zcodec.h"
+
+#define HDR_SIZE (sizeof (uint32_t))
+
+/* deflate can't compress by more than 1032:1.
+ */
+#define MAX_RATIO 1032
+
+int zcodec_compress (const void *data,
+                     size_t size,
+                     void **zdatap,
+                     size_t *zsizep)
+{
+    uint8_t *zdata;
+    uLongf zlen;
+    uint32_t n;
+
+    if ((size > 0 && !data) || !zdatap || !zsizep) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (size > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    zlen = compressBound (size);
+    if (!(zdata = malloc (HDR_SIZE + zlen)))
+        return -1;
+    if (compress2 (zdata + HDR_SIZE,
+                   &zlen,
+                   data,
+                   size,
+                   Z_BEST_SPEED) != Z_OK) {
+        free (zdata);
+        errno = ENOMEM;
+        return -1;
+    }
+    n = htonl (size);
+    memcpy (zdata, &n, HDR_SIZE);
+    *zdatap = zdata;
+    *zsizep = HDR_SIZE + zlen;
+    return 0;
+}
+
+int zcodec_size (const void *zdata, size_t zsize, size_t *sizep)
+{
+    uint32_t n;
+
+    if ((zsize > 0 && !zdata) || !sizep) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (zsize < HDR_SIZE) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy (&n, zdata, HDR_SIZE);
+    if (ntohl (n) > (uint64_t)(zsize - HDR_SIZE) * MAX_RATIO) {
+        errno = EPROTO;
+        return -1;
+    }
+    *sizep = ntohl (n);
+    return 0;
+}
+
+int zcodec_uncompress (const void *zdata,
+                       size_t zsize,
+                       void *data,
+                       size_t size)
+{
+    size_t expected;
+    uLongf len = size;
+
+    if (zcodec_size (zdata, zsize, &expected) < 0)
+        return -1;
+    if ((size > 0 && !data) || size != expected) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (uncompress (data,
+                    &len,
+                    (const uint8_t *)zdata + HDR_SIZE,
+                    zsize - HDR_SIZE) != Z_OK
+        || len != size) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+// vi:ts=4 sw=4 expandtab
@@ -0,0 +1,45 @@
+/************************************************************\
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _PX_ZCODEC_H
+#define _PX_ZCODEC_H
+
+#include <sys/types.h>
+
+/* Compressed data is a zlib stream prefixed with the uncompressed size:
+ *
+ *   [size:u32][zlib stream]
+ *
+ * with the integer in network byte order.
+ */
+
+/* Compress 'data' into a buffer that the caller must free.
+ */
+int zcodec_compress (const void *data,
+                     size_t size,
+                     void **zdata,
+                     size_t *zsize);
+
+/* Get the uncompressed size of 'zdata' (EPROTO if malformed, or if the
+ * size is more than the stream could possibly expand to).
+ */
+int zcodec_size (const void *zdata, size_t zsize, size_t *size);
+
+/* Uncompress 'zdata' into 'data', which must be exactly the size
+ * returned by zcodec_size() (EPROTO if the stream doesn't match).
+ */
+int zcodec_uncompress (const void *zdata,
+                       size_t zsize,
+                       void *data,
+                       size_t size);
+
+#endif // _PX_ZCODEC_H
+
+// vi:ts=4 sw=4 expandtab
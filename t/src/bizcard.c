@@ -17,6 +17,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "src/common/libutil/strlcpy.h"
 
@@ -38,6 +39,9 @@ int main (int argc, char **argv)
     char hostname[128];
     int lrank;
     int srank;
+    const char *s;
+    int count = 1;
+    int get_rank = 0;
 
     /* Initialize and set log prefix to nspace.rank
      */
@@ -129,22 +133,31 @@ int main (int argc, char **argv)
     if ((rc = PMIx_Commit ()) != PMIX_SUCCESS)
         log_msg_exit ("PMIx_Commit: %s", PMIx_Error_string (rc));
 
-    /* Fence
+    /* Fence, repeatedly if BIZCARD_FENCE_COUNT is set, so that later
+     * fences exchange the same data.
      */
     memset (&info, 0, sizeof (info));
     strlcpy (info.key, PMIX_COLLECT_DATA, sizeof (info.key));
     info.value.type = PMIX_BOOL;
     info.value.data.flag = true;
 
-    monotime (&t);
-    if ((rc = PMIx_Fence (NULL, 0, &info, 1)) != PMIX_SUCCESS)
-        log_msg_exit ("PMIx_Fence: %s", PMIx_Error_string (rc));
-    if (self.rank == 0)
-        log_msg ("PMIx_Fence completed in %0.3fs", monotime_since (t) / 1000);
+    if ((s = getenv ("BIZCARD_FENCE_COUNT")))
+        count = strtol (s, NULL, 10);
+    for (int i = 0; i < count; i++) {
+        monotime (&t);
+        if ((rc = PMIx_Fence (NULL, 0, &info, 1)) != PMIX_SUCCESS)
+            log_msg_exit ("PMIx_Fence: %s", PMIx_Error_string (rc));
+        if (self.rank == 0) {
+            log_msg ("PMIx_Fence completed in %0.3fs",
+                     monotime_since (t) / 1000);
+        }
+    }
 
-    /* Fetch specified card(s) and print.
+    /* Fetch specified card(s) and print, on rank 0 or BIZCARD_GET_RANK.
      */
-    if (self.rank == 0 && argc > 1) {
+    if ((s = getenv ("BIZCARD_GET_RANK")))
+        get_rank = strtol (s, NULL, 10);
+    if (self.rank == get_rank && argc > 1) {
         for (int optindex = 1; optindex < argc; optindex++) {
             pmix_proc_t proc;
             pmix_value_t *valp;
@@ -114,4 +114,16 @@ test_expect_success '2n4p barrier works' '
 		${BARRIER}
 '
 
+test_expect_success '2n4p barrier works with dissemination barrier' '
+	run_timeout 30 flux run -N2 -n4 \
+		-opmix.exchange.barrier=dissemination \
+		${BARRIER} --collect-data=false
+'
+
+test_expect_success '2n4p collecting barrier ignores dissemination barrier' '
+	run_timeout 30 flux run -N2 -n4 \
+		-opmix.exchange.barrier=dissemination \
+		${BARRIER} --collect-data=true
+'
+
 test_done
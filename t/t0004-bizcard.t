@@ -37,4 +37,228 @@ test_expect_success '2n4p bizcard exchange works' '
                ${BIZCARD} 1
 '
 
+test_expect_success '2n2p exchange tree follows the overlay topology' '
+       run_timeout 30 flux run -N2 -n2 \
+	       -overbose=2 \
+	       -opmix.exchange.fanout=topology \
+               ${BIZCARD} 1 2>topo.err &&
+       grep "using exchange tree from overlay topology" topo.err
+'
+
+test_expect_success '2n4p bizcard exchange works with ring algorithm' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.algorithm=ring \
+               ${BIZCARD} 2 3 2>ring.err &&
+       grep "my name is .*\.2$" ring.err &&
+       grep "my name is .*\.3$" ring.err
+'
+
+test_expect_success '2n4p bizcard exchange works with bruck algorithm' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.algorithm=bruck \
+               ${BIZCARD} 2 3 2>bruck.err &&
+       grep "my name is .*\.2$" bruck.err &&
+       grep "my name is .*\.3$" bruck.err
+'
+
+test_expect_success '2n4p bizcard exchange works with fanout=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.fanout=1 \
+               ${BIZCARD} 1
+'
+
+test_expect_success '2n4p bizcard exchange works with fanout=auto' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.fanout=auto \
+               ${BIZCARD} 1
+'
+
+test_expect_success '2n4p bizcard exchange works with broadcast=event' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.broadcast=event \
+               ${BIZCARD} 1
+'
+
+test_expect_success '2n4p bizcard exchange works with compress=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.compress=1 \
+               ${BIZCARD} 2 3 2>compress.err &&
+       grep "my name is .*\.2$" compress.err &&
+       grep "my name is .*\.3$" compress.err
+'
+
+test_expect_success '2n4p bizcard exchange works with delta=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.delta=1 \
+               ${BIZCARD} 1
+'
+
+test_expect_success '2n4p repeated fences work with delta=1' '
+       run_timeout 30 flux run -N2 -n4 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+               ${BIZCARD} 1 3 2>delta.err &&
+       grep "my name is .*\.1$" delta.err &&
+       grep "my name is .*\.3$" delta.err
+'
+
+test_expect_success '2n4p repeated fences work with delta=1 and fanout=auto' '
+       run_timeout 30 flux run -N2 -n4 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+	       -opmix.exchange.fanout=auto \
+               ${BIZCARD} 1 3 2>delta-auto.err &&
+       grep "my name is .*\.3$" delta-auto.err
+'
+
+test_expect_success '2n4p bizcard exchange works with stripes=2' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.stripes=2 \
+               ${BIZCARD} 2 3 2>stripes.err &&
+       grep "my name is .*\.2$" stripes.err &&
+       grep "my name is .*\.3$" stripes.err
+'
+
+test_expect_success '2n4p bizcard exchange works with stripes=2 broadcast=event' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.stripes=2 \
+	       -opmix.exchange.broadcast=event \
+               ${BIZCARD} 2 3 2>stripes-event.err &&
+       grep "my name is .*\.2$" stripes-event.err &&
+       grep "my name is .*\.3$" stripes-event.err
+'
+
+test_expect_success '2n4p bizcard exchange works with chunk-size=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -overbose=2 \
+	       -opmix.exchange.chunk-size=1 \
+               ${BIZCARD} 2 3 2>chunk1.err &&
+       grep "using exchange chunk-size=1" chunk1.err &&
+       grep "my name is .*\.2$" chunk1.err &&
+       grep "my name is .*\.3$" chunk1.err
+'
+
+test_expect_success '2n4p bizcard exchange works with chunk-size=64' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.chunk-size=64 \
+               ${BIZCARD} 2 3 2>chunk.err &&
+       grep "my name is .*\.3$" chunk.err
+'
+
+test_expect_success '2n4p bizcard exchange works with chunk-size=64 compress=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.chunk-size=64 \
+	       -opmix.exchange.compress=1 \
+               ${BIZCARD} 2 3 2>chunk-compress.err &&
+       grep "my name is .*\.3$" chunk-compress.err
+'
+
+test_expect_success '2n4p bizcard exchange works with chunk-size=64 fanout=auto' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.chunk-size=64 \
+	       -opmix.exchange.fanout=auto \
+               ${BIZCARD} 2 3 2>chunk-auto.err &&
+       grep "my name is .*\.3$" chunk-auto.err
+'
+
+test_expect_success '2n4p bizcard exchange works with stripes=2 chunk-size=64' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.stripes=2 \
+	       -opmix.exchange.chunk-size=64 \
+               ${BIZCARD} 2 3 2>stripes-chunk.err &&
+       grep "my name is .*\.3$" stripes-chunk.err
+'
+
+test_expect_success '2n4p bizcard exchange works with broadcast=event compress=1' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.broadcast=event \
+	       -opmix.exchange.compress=1 \
+               ${BIZCARD} 2 3 2>event-compress.err &&
+       grep "my name is .*\.3$" event-compress.err
+'
+
+test_expect_success '2n4p bizcard exchange works with broadcast=event fanout=auto' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.broadcast=event \
+	       -opmix.exchange.fanout=auto \
+               ${BIZCARD} 2 3 2>event-auto.err &&
+       grep "my name is .*\.3$" event-auto.err
+'
+
+test_expect_success '2n4p repeated fences work with delta=1 chunk-size=64' '
+       run_timeout 30 flux run -N2 -n4 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+	       -opmix.exchange.chunk-size=64 \
+               ${BIZCARD} 1 3 2>delta-chunk.err &&
+       grep "my name is .*\.3$" delta-chunk.err
+'
+
+test_expect_success '2n4p repeated fences work with delta=1 compress=1' '
+       run_timeout 30 flux run -N2 -n4 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+	       -opmix.exchange.compress=1 \
+               ${BIZCARD} 1 3 2>delta-compress.err &&
+       grep "my name is .*\.3$" delta-compress.err
+'
+
+test_expect_success '2n4p repeated fences work with delta=1 broadcast=event' '
+       run_timeout 30 flux run -N2 -n4 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+	       -opmix.exchange.broadcast=event \
+               ${BIZCARD} 1 3 2>delta-event.err &&
+       grep "my name is .*\.3$" delta-event.err
+'
+
+test_expect_success '2n3p repeated fences work with delta=1 balance=1' '
+       run_timeout 30 flux run -N2 -n3 --env=BIZCARD_FENCE_COUNT=4 \
+	       -opmix.exchange.delta=1 \
+	       -opmix.exchange.balance=1 \
+               ${BIZCARD} 2 2>delta-balance.err &&
+       grep "my name is .*\.2$" delta-balance.err
+'
+
+test_expect_success '2n3p bizcard exchange works with balance=1 fanout=auto' '
+       run_timeout 30 flux run -N2 -n3 \
+	       -opmix.exchange.balance=1 \
+	       -opmix.exchange.fanout=auto \
+               ${BIZCARD} 2 2>balance-auto.err &&
+       grep "my name is .*\.2$" balance-auto.err
+'
+
+test_expect_success '2n4p bizcard exchange works with directory below threshold' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.directory=1048576 \
+               ${BIZCARD} 2 3 2>dir-below.err &&
+       grep "my name is .*\.3$" dir-below.err
+'
+
+test_expect_success '2n4p bizcard exchange works with directory above threshold' '
+       run_timeout 30 flux run -N2 -n4 \
+	       -opmix.exchange.directory=1 \
+               ${BIZCARD} 2 3 2>dir-above.err &&
+       grep "my name is .*\.3$" dir-above.err
+'
+
+test_expect_success '2n3p bizcard exchange works with balance=1' '
+       run_timeout 30 flux run -N2 -n3 \
+	       -opmix.exchange.balance=1 \
+               ${BIZCARD} 1
+'
+
+test_expect_success 'invalid exchange fanout fails' '
+       test_must_fail run_timeout 30 flux run -N2 -n2 \
+	       -opmix.exchange.fanout=0 \
+               ${BIZCARD} 1
+'
+
+test_expect_success 'invalid exchange fanout string fails' '
+       test_must_fail run_timeout 30 flux run -N2 -n2 \
+	       -opmix.exchange.fanout=foo \
+               ${BIZCARD} 1
+'
+
+test_expect_success 'unknown exchange algorithm fails' '
+       test_must_fail run_timeout 30 flux run -N2 -n2 \
+	       -opmix.exchange.algorithm=foo \
+               ${BIZCARD} 1
+'
+
 test_done
@@ -5,6 +5,7 @@ test_description='Exercise server direct_modex callback'
 . `dirname $0`/sharness.sh
 
 GETKEY=${FLUX_BUILD_DIR}/t/src/getkey
+BIZCARD=${FLUX_BUILD_DIR}/t/src/bizcard
 
 export FLUX_SHELL_RC_PATH=${FLUX_BUILD_DIR}/t/etc
 
@@ -18,4 +19,45 @@ test_expect_success '2n2p fetch a nonexistent key on another rank triggers direc
 	grep dmodex_upcall rank0.nokey.err
 '
 
+# With directory=1 the fence skips the data, so rank 0 must fetch the
+# cards of ranks 2 and 3, which live on the other shell, by direct modex.
+test_expect_success '2n4p remote cards are fetched by direct modex' '
+	run_timeout 30 flux run -N2 -n4 \
+		-overbose=2 \
+		-opmix.exchange.directory=1 \
+		${BIZCARD} 2 3 2>fetch.err &&
+	grep dmodex_upcall fetch.err &&
+	grep "my name is .*\.2$" fetch.err &&
+	grep "my name is .*\.3$" fetch.err
+'
+
+test_expect_success '2n4p remote cards are fetched with dmodex cache enabled' '
+	run_timeout 30 flux run -N2 -n4 \
+		-opmix.exchange.directory=1 \
+		-opmix.dmodex.cache=1048576 \
+		${BIZCARD} 2 3 2>cache.err &&
+	grep "my name is .*\.2$" cache.err &&
+	grep "my name is .*\.3$" cache.err
+'
+
+test_expect_success '2n4p remote cards are fetched with dmodex bulk=1' '
+	run_timeout 30 flux run -N2 -n4 \
+		-opmix.exchange.directory=1 \
+		-opmix.dmodex.bulk=1 \
+		${BIZCARD} 2 3 2>bulk.err &&
+	grep "my name is .*\.2$" bulk.err &&
+	grep "my name is .*\.3$" bulk.err
+'
+
+# With a cyclic taskmap, ranks 1 and 3 live on the other shell.
+test_expect_success '2n4p remote cards are fetched with a cyclic taskmap' '
+	run_timeout 30 flux run -N2 -n4 --taskmap=cyclic \
+		-overbose=2 \
+		-opmix.exchange.directory=1 \
+		${BIZCARD} 1 3 2>cyclic.err &&
+	grep dmodex_upcall cyclic.err &&
+	grep "my name is .*\.1$" cyclic.err &&
+	grep "my name is .*\.3$" cyclic.err
+'
+
 test_done
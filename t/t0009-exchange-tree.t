@@ -0,0 +1,113 @@
+#!/bin/sh
+
+test_description='Exercise exchange tree shapes on a larger instance.'
+
+. `dirname $0`/sharness.sh
+
+BIZCARD=${FLUX_BUILD_DIR}/t/src/bizcard
+VERSION=${FLUX_BUILD_DIR}/t/src/version
+
+export FLUX_SHELL_RC_PATH=${FLUX_BUILD_DIR}/t/etc
+
+# With 8 shells the tree has interior shells, which relay data, and
+# fanout=auto runs its tuning exchange (it is skipped for 2 shells).
+# The cards are fetched on the last rank, which is on the last shell, so
+# the data has gone up and back down the tree.
+test_under_flux 8
+
+test_expect_success 'print pmix library version' '
+	${VERSION}
+'
+
+test_expect_success '8n8p bizcard exchange works' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_GET_RANK=7 \
+		${BIZCARD} 0 3 2>basic.err &&
+	grep "my name is .*\.0$" basic.err &&
+	grep "my name is .*\.3$" basic.err
+'
+
+test_expect_success '8n8p repeated fences autotune the fanout' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_FENCE_COUNT=4 \
+		--env=BIZCARD_GET_RANK=7 \
+		-overbose=2 \
+		-opmix.exchange.fanout=auto \
+		${BIZCARD} 0 3 2>auto.err &&
+	grep "using k=.* (autotune)" auto.err &&
+	grep "autotune: using k=" auto.err &&
+	grep "my name is .*\.0$" auto.err &&
+	grep "my name is .*\.3$" auto.err
+'
+
+test_expect_success '8n8p fanout=auto works with broadcast=event' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_FENCE_COUNT=4 \
+		--env=BIZCARD_GET_RANK=7 \
+		-opmix.exchange.fanout=auto \
+		-opmix.exchange.broadcast=event \
+		${BIZCARD} 0 3 2>auto-event.err &&
+	grep "my name is .*\.0$" auto-event.err &&
+	grep "my name is .*\.3$" auto-event.err
+'
+
+test_expect_success '8n8p chunks are relayed down a chain' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_GET_RANK=7 \
+		-opmix.exchange.fanout=1 \
+		-opmix.exchange.chunk-size=64 \
+		${BIZCARD} 0 3 2>chain-chunk.err &&
+	grep "my name is .*\.0$" chain-chunk.err &&
+	grep "my name is .*\.3$" chain-chunk.err
+'
+
+test_expect_success '8n8p chunks are relayed with fanout=auto' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_FENCE_COUNT=4 \
+		--env=BIZCARD_GET_RANK=7 \
+		-opmix.exchange.fanout=auto \
+		-opmix.exchange.chunk-size=64 \
+		${BIZCARD} 0 3 2>auto-chunk.err &&
+	grep "my name is .*\.0$" auto-chunk.err &&
+	grep "my name is .*\.3$" auto-chunk.err
+'
+
+test_expect_success '8n8p repeated fences work with delta=1 down a chain' '
+	run_timeout 60 flux run -N8 -n8 --env=BIZCARD_FENCE_COUNT=4 \
+		--env=BIZCARD_GET_RANK=7 \
+		-opmix.exchange.fanout=1 \
+		-opmix.exchange.delta=1 \
+		${BIZCARD} 0 3 2>chain-delta.err &&
+	grep "my name is .*\.0$" chain-delta.err &&
+	grep "my name is .*\.3$" chain-delta.err
+'
+
+# -n12 places 2 tasks on each of the first 4 shells and 1 on the others,
+# so the balanced tree differs from the k-ary tree.
+test_expect_success '8n12p bizcard exchange works with balance=1' '
+	run_timeout 60 flux run -N8 -n12 --env=BIZCARD_GET_RANK=11 \
+		-overbose=2 \
+		-opmix.exchange.fanout=2 \
+		-opmix.exchange.balance=1 \
+		${BIZCARD} 0 1 2>balance.err &&
+	grep "using exchange balance" balance.err &&
+	grep "my name is .*\.0$" balance.err &&
+	grep "my name is .*\.1$" balance.err
+'
+
+test_expect_success '8n12p repeated fences work with balance=1 fanout=auto' '
+	run_timeout 60 flux run -N8 -n12 --env=BIZCARD_FENCE_COUNT=4 \
+		--env=BIZCARD_GET_RANK=11 \
+		-opmix.exchange.fanout=auto \
+		-opmix.exchange.balance=1 \
+		${BIZCARD} 0 1 2>balance-auto.err &&
+	grep "my name is .*\.0$" balance-auto.err &&
+	grep "my name is .*\.1$" balance-auto.err
+'
+
+test_expect_success '8n12p bizcard exchange works with balance=1 chunk-size=64' '
+	run_timeout 60 flux run -N8 -n12 --env=BIZCARD_GET_RANK=11 \
+		-opmix.exchange.fanout=2 \
+		-opmix.exchange.balance=1 \
+		-opmix.exchange.chunk-size=64 \
+		${BIZCARD} 0 1 2>balance-chunk.err &&
+	grep "my name is .*\.0$" balance-chunk.err &&
+	grep "my name is .*\.1$" balance-chunk.err
+'
+
+test_done